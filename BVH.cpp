@@ -0,0 +1,584 @@
+#include "BVH.h"
+#include "Bounds.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define BVH_PACKET_SSE
+#include <emmintrin.h>
+#endif
+
+//Number of bins used when evaluating the SAH along each axis
+#define BVH_BINS 16
+//Leaves are never split below this many triangles
+#define BVH_MIN_LEAF_SIZE 2
+//Deepest level a node can be split to, which also bounds the traversal stack
+#define BVH_MAX_DEPTH 64
+//Relative costs of a node traversal step and a ray test against one triangle block
+#define BVH_TRAVERSAL_COST 1.0f
+#define BVH_INTERSECTION_COST 1.0f
+
+namespace
+{
+    struct Bin
+    {
+        Cartesian3 boundsMin;
+        Cartesian3 boundsMax;
+        unsigned int count;
+    };
+
+    void emptyBounds(Cartesian3 &boundsMin, Cartesian3 &boundsMax)
+    {
+        float big = std::numeric_limits<float>::max();
+        boundsMin = Cartesian3(big, big, big);
+        boundsMax = Cartesian3(-big, -big, -big);
+    }
+
+    //The rays of a packet laid out for the box tests
+    struct PacketRays
+    {
+        alignas(16) float originX[BVH_PACKET_SIZE];
+        alignas(16) float originY[BVH_PACKET_SIZE];
+        alignas(16) float originZ[BVH_PACKET_SIZE];
+        alignas(16) float inverseX[BVH_PACKET_SIZE];
+        alignas(16) float inverseY[BVH_PACKET_SIZE];
+        alignas(16) float inverseZ[BVH_PACKET_SIZE];
+    };
+
+    //Slab test of every ray in the packet against one box, returning a bit mask of the rays that enter it
+    //(no further than their tMax) and each ray's entry distance. Agrees exactly with BVH::intersectBox
+    int intersectBoxPacket(const Cartesian3 &boundsMin, const Cartesian3 &boundsMax, const PacketRays &p, const float *tMax, float *tNear)
+    {
+#if defined(BVH_PACKET_SSE) && BVH_PACKET_SIZE == 4
+        //std::min(a, b) is (b < a) ? b : a, which is _mm_min_ps(b, a) (and likewise for max),
+        //so the operands are swapped below to treat NaNs the same way as the single ray test
+        __m128 originX = _mm_load_ps(p.originX), originY = _mm_load_ps(p.originY), originZ = _mm_load_ps(p.originZ);
+        __m128 inverseX = _mm_load_ps(p.inverseX), inverseY = _mm_load_ps(p.inverseY), inverseZ = _mm_load_ps(p.inverseZ);
+
+        __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin.x), originX), inverseX);
+        __m128 tx2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax.x), originX), inverseX);
+        __m128 near = _mm_min_ps(tx2, tx1);
+        __m128 far = _mm_max_ps(tx2, tx1);
+
+        __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin.y), originY), inverseY);
+        __m128 ty2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax.y), originY), inverseY);
+        near = _mm_max_ps(_mm_min_ps(ty2, ty1), near);
+        far = _mm_min_ps(_mm_max_ps(ty2, ty1), far);
+
+        __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMin.z), originZ), inverseZ);
+        __m128 tz2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(boundsMax.z), originZ), inverseZ);
+        near = _mm_max_ps(_mm_min_ps(tz2, tz1), near);
+        far = _mm_min_ps(_mm_max_ps(tz2, tz1), far);
+
+        __m128 zero = _mm_setzero_ps();
+        __m128 hit = _mm_and_ps(_mm_cmpge_ps(far, near), _mm_cmpgt_ps(far, zero));
+        hit = _mm_and_ps(hit, _mm_cmple_ps(near, _mm_loadu_ps(tMax)));
+        _mm_storeu_ps(tNear, _mm_max_ps(zero, near));
+        return _mm_movemask_ps(hit);
+#else
+        int mask = 0;
+        for (int k = 0; k < BVH_PACKET_SIZE; k++)
+        {
+            Cartesian3 origin(p.originX[k], p.originY[k], p.originZ[k]);
+            Cartesian3 inverseDirection(p.inverseX[k], p.inverseY[k], p.inverseZ[k]);
+            tNear[k] = BVH::intersectBox(boundsMin, boundsMax, origin, inverseDirection, tMax[k]);
+            if (tNear[k] >= 0)
+                mask |= 1 << k;
+        }
+        return mask;
+#endif
+    }
+
+    //Nearest entry distance among the rays in mask
+    float nearestEntry(int mask, const float *tNear)
+    {
+        float nearest = std::numeric_limits<float>::max();
+        for (int k = 0; k < BVH_PACKET_SIZE; k++)
+            if (mask & (1 << k))
+                nearest = std::min(nearest, tNear[k]);
+        return nearest;
+    }
+
+    //A block is tested as a whole, so the cost of a leaf goes up in steps of TRIANGLE_BLOCK_SIZE triangles
+    unsigned int blockCount(unsigned int triangleCount)
+    {
+        return (triangleCount + TRIANGLE_BLOCK_SIZE - 1) / TRIANGLE_BLOCK_SIZE;
+    }
+}
+
+BVH::BVH()
+{
+}
+
+bool BVH::empty() const
+{
+    return nodes.empty();
+}
+
+void BVH::build(const std::vector<CompactTriangle> &triangles)
+{
+    nodes.clear();
+    blocks.clear();
+
+    unsigned int nTriangles = triangles.size();
+    if (nTriangles == 0)
+        return;
+
+    triangleMin.resize(nTriangles);
+    triangleMax.resize(nTriangles);
+    centroids.resize(nTriangles);
+    triangleIndices.resize(nTriangles);
+
+    for (unsigned int i = 0; i < nTriangles; i++)
+    {
+        Cartesian3 P = triangles[i].v0;
+        Cartesian3 Q = P + triangles[i].edge1;
+        Cartesian3 R = P + triangles[i].edge2;
+
+        //Pad a little for the slack CompactTriangle::intersect allows around the edges
+        Cartesian3 boundsMin = minimum(P, minimum(Q, R));
+        Cartesian3 boundsMax = maximum(P, maximum(Q, R));
+        Cartesian3 extent = boundsMax - boundsMin;
+        float pad = 0.00001f * (1.0f + std::max(extent.x, std::max(extent.y, extent.z)));
+
+        triangleMin[i] = boundsMin - Cartesian3(pad, pad, pad);
+        triangleMax[i] = boundsMax + Cartesian3(pad, pad, pad);
+        centroids[i] = (P + Q + R) / 3.0f;
+        triangleIndices[i] = i;
+    }
+
+    //A binary tree has at most 2n - 1 nodes
+    nodes.reserve(2 * nTriangles);
+
+    Node root;
+    root.leftOrFirst = 0;
+    root.count = nTriangles;
+    nodes.push_back(root);
+
+    updateBounds(0);
+    subdivide(0, 0);
+
+    //Pack the triangles into blocks in leaf order, so each leaf reads one contiguous run of memory
+    for (unsigned int n = 0; n < nodes.size(); n++)
+    {
+        Node &node = nodes[n];
+        if (node.count == 0)
+            continue;
+
+        unsigned int firstBlock = blocks.size();
+        blocks.resize(firstBlock + blockCount(node.count));
+        for (unsigned int i = 0; i < node.count; i++)
+        {
+            unsigned int triangle = triangleIndices[node.leftOrFirst + i];
+            blocks[firstBlock + i / TRIANGLE_BLOCK_SIZE].set(i % TRIANGLE_BLOCK_SIZE, triangles[triangle], triangle);
+        }
+        node.leftOrFirst = firstBlock;
+    }
+
+    //The per-triangle build data is not needed for traversal
+    triangleIndices.clear();
+    triangleMin.clear();
+    triangleMax.clear();
+    centroids.clear();
+}
+
+void BVH::updateBounds(unsigned int nodeIndex)
+{
+    Node &node = nodes[nodeIndex];
+    emptyBounds(node.boundsMin, node.boundsMax);
+
+    for (unsigned int i = 0; i < node.count; i++)
+    {
+        unsigned int triangle = triangleIndices[node.leftOrFirst + i];
+        node.boundsMin = minimum(node.boundsMin, triangleMin[triangle]);
+        node.boundsMax = maximum(node.boundsMax, triangleMax[triangle]);
+    }
+}
+
+float BVH::findBestSplit(const Node &node, int &axis, float &splitPosition)
+{
+    float bestCost = std::numeric_limits<float>::max();
+
+    for (int a = 0; a < 3; a++)
+    {
+        //Bin on the centroid bounds, since that is what decides which side a triangle goes to
+        float centroidMin = std::numeric_limits<float>::max();
+        float centroidMax = -std::numeric_limits<float>::max();
+        for (unsigned int i = 0; i < node.count; i++)
+        {
+            float c = centroids[triangleIndices[node.leftOrFirst + i]][a];
+            centroidMin = std::min(centroidMin, c);
+            centroidMax = std::max(centroidMax, c);
+        }
+
+        if (centroidMin == centroidMax)
+            continue;
+
+        Bin bins[BVH_BINS];
+        for (int b = 0; b < BVH_BINS; b++)
+        {
+            emptyBounds(bins[b].boundsMin, bins[b].boundsMax);
+            bins[b].count = 0;
+        }
+
+        float scale = BVH_BINS / (centroidMax - centroidMin);
+        for (unsigned int i = 0; i < node.count; i++)
+        {
+            unsigned int triangle = triangleIndices[node.leftOrFirst + i];
+            int b = std::min(BVH_BINS - 1, int((centroids[triangle][a] - centroidMin) * scale));
+            bins[b].count++;
+            bins[b].boundsMin = minimum(bins[b].boundsMin, triangleMin[triangle]);
+            bins[b].boundsMax = maximum(bins[b].boundsMax, triangleMax[triangle]);
+        }
+
+        //Sweep from both sides to get the area and count on either side of each bin boundary
+        float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+        unsigned int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+
+        Cartesian3 leftMin, leftMax, rightMin, rightMax;
+        emptyBounds(leftMin, leftMax);
+        emptyBounds(rightMin, rightMax);
+        unsigned int leftSum = 0, rightSum = 0;
+
+        for (int b = 0; b < BVH_BINS - 1; b++)
+        {
+            leftSum += bins[b].count;
+            leftCount[b] = leftSum;
+            if (bins[b].count > 0)
+            {
+                leftMin = minimum(leftMin, bins[b].boundsMin);
+                leftMax = maximum(leftMax, bins[b].boundsMax);
+            }
+            leftArea[b] = leftSum > 0 ? surfaceArea(leftMin, leftMax) : 0.0f;
+
+            int r = BVH_BINS - 1 - b;
+            rightSum += bins[r].count;
+            rightCount[r - 1] = rightSum;
+            if (bins[r].count > 0)
+            {
+                rightMin = minimum(rightMin, bins[r].boundsMin);
+                rightMax = maximum(rightMax, bins[r].boundsMax);
+            }
+            rightArea[r - 1] = rightSum > 0 ? surfaceArea(rightMin, rightMax) : 0.0f;
+        }
+
+        for (int b = 0; b < BVH_BINS - 1; b++)
+        {
+            if (leftCount[b] == 0 || rightCount[b] == 0)
+                continue;
+
+            float cost = blockCount(leftCount[b]) * leftArea[b] + blockCount(rightCount[b]) * rightArea[b];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                axis = a;
+                splitPosition = centroidMin + (b + 1) / scale;
+            }
+        }
+    }
+
+    return bestCost;
+}
+
+void BVH::subdivide(unsigned int nodeIndex, int depth)
+{
+    //Copy what we need, since pushing children may reallocate the node array
+    Node node = nodes[nodeIndex];
+    if (node.count <= BVH_MIN_LEAF_SIZE || depth >= BVH_MAX_DEPTH)
+        return;
+
+    int axis = -1;
+    float splitPosition = 0.0f;
+    float splitCost = findBestSplit(node, axis, splitPosition);
+    if (axis < 0)
+        return;
+
+    //Compare the SAH cost of splitting against the cost of keeping this node as a leaf
+    float parentArea = surfaceArea(node.boundsMin, node.boundsMax);
+    float leafCost = BVH_INTERSECTION_COST * blockCount(node.count);
+    float splitTotal = BVH_TRAVERSAL_COST + BVH_INTERSECTION_COST * splitCost / parentArea;
+    if (parentArea > 0.0f && splitTotal >= leafCost)
+        return;
+
+    //Partition the triangle indices in place around the split plane
+    unsigned int *first = &triangleIndices[node.leftOrFirst];
+    unsigned int *last = first + node.count;
+    unsigned int *middle = std::partition(first, last, [&](unsigned int triangle)
+    {
+        return centroids[triangle][axis] < splitPosition;
+    });
+
+    unsigned int leftCount = middle - first;
+    if (leftCount == 0 || leftCount == node.count)
+        return;
+
+    Node left, right;
+    left.leftOrFirst = node.leftOrFirst;
+    left.count = leftCount;
+    right.leftOrFirst = node.leftOrFirst + leftCount;
+    right.count = node.count - leftCount;
+
+    unsigned int leftIndex = nodes.size();
+    nodes.push_back(left);
+    nodes.push_back(right);
+
+    nodes[nodeIndex].leftOrFirst = leftIndex;
+    nodes[nodeIndex].count = 0;
+
+    updateBounds(leftIndex);
+    updateBounds(leftIndex + 1);
+    subdivide(leftIndex, depth + 1);
+    subdivide(leftIndex + 1, depth + 1);
+}
+
+float BVH::intersectBox(const Cartesian3 &boundsMin, const Cartesian3 &boundsMax, const Cartesian3 &origin, const Cartesian3 &inverseDirection, float tMax)
+{
+    float tx1 = (boundsMin.x - origin.x) * inverseDirection.x;
+    float tx2 = (boundsMax.x - origin.x) * inverseDirection.x;
+    float tNear = std::min(tx1, tx2);
+    float tFar = std::max(tx1, tx2);
+
+    float ty1 = (boundsMin.y - origin.y) * inverseDirection.y;
+    float ty2 = (boundsMax.y - origin.y) * inverseDirection.y;
+    tNear = std::max(tNear, std::min(ty1, ty2));
+    tFar = std::min(tFar, std::max(ty1, ty2));
+
+    float tz1 = (boundsMin.z - origin.z) * inverseDirection.z;
+    float tz2 = (boundsMax.z - origin.z) * inverseDirection.z;
+    tNear = std::max(tNear, std::min(tz1, tz2));
+    tFar = std::min(tFar, std::max(tz1, tz2));
+
+    //Ties on t are kept (<= rather than <), so equally distant triangles can still win on index
+    if (tFar >= tNear && tFar > 0 && tNear <= tMax)
+        return std::max(tNear, 0.0f);
+
+    return -1;
+}
+
+bool BVH::closestHit(const Ray &r, float &tHit, float &uHit, float &vHit, unsigned int &triangleHit, float tMax) const
+{
+    if (nodes.empty())
+        return false;
+
+    Cartesian3 inverseDirection(1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z);
+
+    float tBest = tMax;
+    float uBest = 0, vBest = 0;
+    unsigned int best = std::numeric_limits<unsigned int>::max();
+    bool found = false;
+
+    //Explicit stack of nodes still to visit, along with the distance at which the ray enters them
+    struct StackEntry
+    {
+        unsigned int node;
+        float tNear;
+    };
+    StackEntry stack[BVH_MAX_DEPTH + 1];
+    int stackSize = 0;
+
+    float tRoot = intersectBox(nodes[0].boundsMin, nodes[0].boundsMax, r.origin, inverseDirection, tBest);
+    if (tRoot >= 0)
+        stack[stackSize++] = {0, tRoot};
+
+    while (stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+
+        //A closer hit may have been found since this node was pushed
+        if (entry.tNear > tBest)
+            continue;
+
+        const Node &node = nodes[entry.node];
+
+        if (node.count > 0)
+        {
+            unsigned int lastBlock = node.leftOrFirst + blockCount(node.count);
+            for (unsigned int b = node.leftOrFirst; b < lastBlock; b++)
+                found |= blocks[b].intersect(r, tBest, uBest, vBest, best);
+            continue;
+        }
+
+        //Visit the nearer child first so tBest shrinks as early as possible
+        unsigned int left = node.leftOrFirst;
+        unsigned int right = left + 1;
+        float tLeft = intersectBox(nodes[left].boundsMin, nodes[left].boundsMax, r.origin, inverseDirection, tBest);
+        float tRight = intersectBox(nodes[right].boundsMin, nodes[right].boundsMax, r.origin, inverseDirection, tBest);
+
+        if (tLeft >= 0 && tRight >= 0)
+        {
+            if (tLeft <= tRight)
+            {
+                stack[stackSize++] = {right, tRight};
+                stack[stackSize++] = {left, tLeft};
+            }
+            else
+            {
+                stack[stackSize++] = {left, tLeft};
+                stack[stackSize++] = {right, tRight};
+            }
+        }
+        else if (tLeft >= 0)
+            stack[stackSize++] = {left, tLeft};
+        else if (tRight >= 0)
+            stack[stackSize++] = {right, tRight};
+    }
+
+    if (found)
+    {
+        tHit = tBest;
+        uHit = uBest;
+        vHit = vBest;
+        triangleHit = best;
+    }
+
+    return found;
+}
+
+bool BVH::anyHit(const Ray &r, float tMax, const std::vector<bool> &castsShadow) const
+{
+    if (nodes.empty())
+        return false;
+
+    Cartesian3 inverseDirection(1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z);
+
+    //Any hit will do, so there is no need to sort the children or remember where the ray entered them
+    unsigned int stack[BVH_MAX_DEPTH + 1];
+    int stackSize = 0;
+
+    if (intersectBox(nodes[0].boundsMin, nodes[0].boundsMax, r.origin, inverseDirection, tMax) >= 0)
+        stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node &node = nodes[stack[--stackSize]];
+
+        if (node.count > 0)
+        {
+            unsigned int lastBlock = node.leftOrFirst + blockCount(node.count);
+            for (unsigned int b = node.leftOrFirst; b < lastBlock; b++)
+            {
+                alignas(32) float t[TRIANGLE_BLOCK_SIZE];
+                int mask = blocks[b].hitLanes(r, tMax, t);
+                for (int lane = 0; mask != 0; lane++, mask >>= 1)
+                    if ((mask & 1) && t[lane] < tMax && castsShadow[blocks[b].index[lane]])
+                        return true;
+            }
+            continue;
+        }
+
+        unsigned int left = node.leftOrFirst;
+        if (intersectBox(nodes[left].boundsMin, nodes[left].boundsMax, r.origin, inverseDirection, tMax) >= 0)
+            stack[stackSize++] = left;
+        if (intersectBox(nodes[left + 1].boundsMin, nodes[left + 1].boundsMax, r.origin, inverseDirection, tMax) >= 0)
+            stack[stackSize++] = left + 1;
+    }
+
+    return false;
+}
+
+void BVH::closestHitPacket(const Ray *rays, bool *found, float *tHit, float *uHit, float *vHit, unsigned int *triangleHit,
+                           const float *tMax) const
+{
+    float tBest[BVH_PACKET_SIZE];
+    float uBest[BVH_PACKET_SIZE], vBest[BVH_PACKET_SIZE];
+    unsigned int best[BVH_PACKET_SIZE];
+    PacketRays packet;
+
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+    {
+        found[k] = false;
+        tBest[k] = tMax != nullptr ? tMax[k] : std::numeric_limits<float>::max();
+        uBest[k] = vBest[k] = 0;
+        best[k] = std::numeric_limits<unsigned int>::max();
+
+        packet.originX[k] = rays[k].origin.x;
+        packet.originY[k] = rays[k].origin.y;
+        packet.originZ[k] = rays[k].origin.z;
+        packet.inverseX[k] = 1.0f / rays[k].direction.x;
+        packet.inverseY[k] = 1.0f / rays[k].direction.y;
+        packet.inverseZ[k] = 1.0f / rays[k].direction.z;
+    }
+
+    if (nodes.empty())
+        return;
+
+    //As in closestHit(), but each entry also records which rays entered the node and where
+    struct StackEntry
+    {
+        unsigned int node;
+        int mask;
+        float tNear[BVH_PACKET_SIZE];
+    };
+    StackEntry stack[BVH_MAX_DEPTH + 1];
+    int stackSize = 0;
+
+    StackEntry root;
+    root.node = 0;
+    root.mask = intersectBoxPacket(nodes[0].boundsMin, nodes[0].boundsMax, packet, tBest, root.tNear);
+    if (root.mask != 0)
+        stack[stackSize++] = root;
+
+    while (stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+
+        //Drop the rays that have found a closer hit since this node was pushed
+        int mask = entry.mask;
+        for (int k = 0; k < BVH_PACKET_SIZE; k++)
+            if ((mask & (1 << k)) && entry.tNear[k] > tBest[k])
+                mask &= ~(1 << k);
+        if (mask == 0)
+            continue;
+
+        const Node &node = nodes[entry.node];
+
+        if (node.count > 0)
+        {
+            unsigned int lastBlock = node.leftOrFirst + blockCount(node.count);
+            for (int k = 0; k < BVH_PACKET_SIZE; k++)
+            {
+                if (!(mask & (1 << k)))
+                    continue;
+                for (unsigned int b = node.leftOrFirst; b < lastBlock; b++)
+                    found[k] |= blocks[b].intersect(rays[k], tBest[k], uBest[k], vBest[k], best[k]);
+            }
+            continue;
+        }
+
+        StackEntry left, right;
+        left.node = node.leftOrFirst;
+        right.node = left.node + 1;
+        left.mask = mask & intersectBoxPacket(nodes[left.node].boundsMin, nodes[left.node].boundsMax, packet, tBest, left.tNear);
+        right.mask = mask & intersectBoxPacket(nodes[right.node].boundsMin, nodes[right.node].boundsMax, packet, tBest, right.tNear);
+
+        //Visit the child the packet reaches first before the other one
+        if (left.mask != 0 && right.mask != 0)
+        {
+            if (nearestEntry(left.mask, left.tNear) <= nearestEntry(right.mask, right.tNear))
+            {
+                stack[stackSize++] = right;
+                stack[stackSize++] = left;
+            }
+            else
+            {
+                stack[stackSize++] = left;
+                stack[stackSize++] = right;
+            }
+        }
+        else if (left.mask != 0)
+            stack[stackSize++] = left;
+        else if (right.mask != 0)
+            stack[stackSize++] = right;
+    }
+
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+    {
+        if (!found[k])
+            continue;
+        tHit[k] = tBest[k];
+        uHit[k] = uBest[k];
+        vHit[k] = vBest[k];
+        triangleHit[k] = best[k];
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <limits>
+#include "Cartesian3.h"
+#include "Triangle.h"
+#include "Ray.h"
+#include "TriangleBlock.h"
+
+//Number of rays traced together by closestHitPacket()
+#define BVH_PACKET_SIZE 4
+
+//Bounding volume hierarchy over a list of triangles, built with the surface area heuristic (SAH)
+//The caller's triangle list is left untouched; hits are reported by index into it
+class BVH
+{
+public:
+    struct Node
+    {
+        Cartesian3 boundsMin;
+        Cartesian3 boundsMax;
+
+        //Interior node: index of the left child (the right child is always stored next to it)
+        //Leaf node: index of the first of its blocks in blocks
+        unsigned int leftOrFirst;
+
+        //Number of triangles in a leaf, 0 for an interior node
+        unsigned int count;
+    };
+
+    std::vector<Node> nodes;
+
+    //Copy of the intersection data in leaf order, packed TRIANGLE_BLOCK_SIZE to a block
+    //Each leaf owns whole blocks, so a leaf of n triangles is (n + TRIANGLE_BLOCK_SIZE - 1) / TRIANGLE_BLOCK_SIZE blocks
+    std::vector<TriangleBlock> blocks;
+
+    BVH();
+
+    //Rebuilds the hierarchy from scratch
+    void build(const std::vector<CompactTriangle> &triangles);
+
+    bool empty() const;
+
+    //Finds the closest triangle hit by r (with the barycentric weights u, v of the hit), returns false if there is none
+    //Ties on t are resolved towards the lowest triangle index, which matches the linear scan in Scene
+    //Hits beyond tMax are ignored (one exactly at tMax may still be reported), e.g. when a closer one is already known
+    bool closestHit(const Ray &r, float &tHit, float &uHit, float &vHit, unsigned int &triangleHit,
+                    float tMax = std::numeric_limits<float>::max()) const;
+
+    //Returns true as soon as r hits any triangle at 0 < t < tMax whose entry in castsShadow is set
+    //Triangles are visited in no particular order, so nothing is said about which one was found
+    bool anyHit(const Ray &r, float tMax, const std::vector<bool> &castsShadow) const;
+
+    //The same query for BVH_PACKET_SIZE rays at once, walking the tree once for all of them
+    //Meant for coherent rays (e.g. neighbouring primary rays), gives exactly the same hits as closestHit()
+    //tMax, if given, holds one limit per ray
+    void closestHitPacket(const Ray *rays, bool *found, float *tHit, float *uHit, float *vHit, unsigned int *triangleHit,
+                          const float *tMax = nullptr) const;
+
+    //Slab test, returns the entry distance of r into the box (or a negative value on a miss)
+    static float intersectBox(const Cartesian3 &boundsMin, const Cartesian3 &boundsMax, const Cartesian3 &origin, const Cartesian3 &inverseDirection, float tMax);
+
+private:
+    //Per-triangle data that is only needed while building
+    std::vector<unsigned int> triangleIndices;
+    std::vector<Cartesian3> triangleMin;
+    std::vector<Cartesian3> triangleMax;
+    std::vector<Cartesian3> centroids;
+
+    void updateBounds(unsigned int nodeIndex);
+    void subdivide(unsigned int nodeIndex, int depth);
+    float findBestSplit(const Node &node, int &axis, float &splitPosition);
+};
+
+#endif // BVH_H
@@ -0,0 +1,119 @@
+#include "BandedRender.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+BandedRender::BandedRender(Raytracer *raytracer)
+{
+    this->raytracer = raytracer;
+    bandsSkipped = 0;
+    bandsRendered = 0;
+}
+
+bool BandedRender::render(const std::string &filename, TileWriter::Format format, long width, long height, long bandHeight, bool resume)
+{
+    bandsSkipped = 0;
+    bandsRendered = 0;
+    if (width < 1 || height < 1 || bandHeight < 1)
+        return false;
+    long nBands = (height + bandHeight - 1) / bandHeight;
+
+    //The journal starts with a line describing the render, so that a different one is never resumed by mistake
+    std::string journalName = filename + ".bands";
+    std::ostringstream description;
+    description << width << " " << height << " " << bandHeight << " " << (format == TileWriter::PFM ? "PFM" : "PPM");
+
+    std::vector<bool> done(nBands, false);
+    bool journalMatches = false;
+    if (resume)
+    {
+        std::ifstream oldJournal(journalName.c_str());
+        std::string line;
+        if (std::getline(oldJournal, line) && line == description.str())
+        {
+            journalMatches = true;
+            //A line without its newline was cut off part way through by the crash, so it is ignored
+            while (std::getline(oldJournal, line) && !oldJournal.eof())
+            {
+                long band = std::atol(line.c_str());
+                if (band >= 0 && band < nBands)
+                    done[band] = true;
+            }
+        }
+    }
+
+    //The old bands are only any use if the image they were written into is still there
+    TileWriter writer;
+    if (!writer.open(filename, format, width, height, journalMatches))
+        return false;
+    if (!writer.resumed())
+        std::fill(done.begin(), done.end(), false);
+
+    std::ofstream journal(journalName.c_str(), writer.resumed() ? std::ios::app : std::ios::trunc);
+    if (!writer.resumed())
+        journal << description.str() << std::endl;
+    bool good = journal.good();
+
+    RGBAImage *wholeFrameBuffer = raytracer->frameBuffer;
+    RGBAImage band;
+    FloatImage radianceBand;
+    for (long b = 0; b < nBands && good; b++)
+    {
+        if (done[b])
+        {
+            bandsSkipped++;
+            continue;
+        }
+
+        long firstRow = b * bandHeight;
+        long rows = std::min(bandHeight, height - firstRow);
+        if (!band.Resize(width, rows) || (format == TileWriter::PFM && !radianceBand.Resize(width, rows)))
+        {
+            good = false;
+            break;
+        }
+
+        raytracer->frameBuffer = &band;
+        raytracer->setWindow(width, height, 0, firstRow);
+        raytracer->Render();
+        //A cancelled band is left out of the journal, so resuming renders it again
+        if (raytracer->cancelRequested)
+        {
+            good = false;
+            break;
+        }
+
+        TileScheduler::Tile wholeBand;
+        wholeBand.x = 0;
+        wholeBand.y = 0;
+        wholeBand.width = width;
+        wholeBand.height = rows;
+        if (format == TileWriter::PFM)
+        {
+            raytracer->radiance(wholeBand, radianceBand);
+            writer.writeTile(wholeBand, radianceBand, firstRow);
+        }
+        else
+            writer.writeTile(wholeBand, band, firstRow);
+
+        //The band is only recorded once its pixels have been handed over to the file
+        good = writer.flush();
+        if (good)
+            journal << b << std::endl;
+        good = good && journal.good();
+        bandsRendered++;
+    }
+
+    raytracer->frameBuffer = wholeFrameBuffer;
+    raytracer->setWindow(0, 0, 0, 0);
+    good = writer.close() && good;
+    journal.close();
+
+    //A finished image needs no journal
+    if (good)
+        std::remove(journalName.c_str());
+    return good;
+}
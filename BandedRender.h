@@ -0,0 +1,32 @@
+#ifndef BANDEDRENDER_H
+#define BANDEDRENDER_H
+
+#include <string>
+#include "Raytracer.h"
+#include "TileWriter.h"
+
+//Renders an image a band of rows at a time straight into its output file, for images too large to render in memory
+//(a 16k x 16k frame would need several gigabytes of accumulation buffers). Only one band's buffers exist at once,
+//so memory depends on the width and the band height, not the height of the image, and each band goes to its place
+//in the file as soon as it is done (see TileWriter)
+//Every finished band is also recorded in a journal next to the output (its name plus ".bands"), which is deleted once
+//the image is complete. A render that is killed part way can then be resumed: the bands in the journal are kept and skipped
+class BandedRender
+{
+public:
+    explicit BandedRender(Raytracer *raytracer);
+
+    //Renders a width x height image into filename, in bands of bandHeight rows, with the raytracer's scene and parameters
+    //With resume, an unfinished render of the same image into filename (same size, format and band height) carries on;
+    //otherwise, or if there is none, it starts from scratch. Returns false if the file cannot be written
+    bool render(const std::string &filename, TileWriter::Format format, long width, long height, long bandHeight, bool resume);
+
+    //Bands of the last render() that an earlier, interrupted one had already finished, and that it rendered itself
+    unsigned int bandsSkipped;
+    unsigned int bandsRendered;
+
+private:
+    Raytracer *raytracer;
+};
+
+#endif // BANDEDRENDER_H
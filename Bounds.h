@@ -0,0 +1,27 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <algorithm>
+#include "Cartesian3.h"
+
+//Helpers for the axis aligned boxes of the BVHs and the light tree, inline since they sit in the inner loops of the builds
+
+//Componentwise minimum and maximum, e.g. to grow a box around a point or another box
+inline Cartesian3 minimum(const Cartesian3 &a, const Cartesian3 &b)
+{
+    return Cartesian3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z));
+}
+
+inline Cartesian3 maximum(const Cartesian3 &a, const Cartesian3 &b)
+{
+    return Cartesian3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z));
+}
+
+//Half the surface area of a box, which is all the surface area heuristic needs, as only ratios of it are used
+inline float surfaceArea(const Cartesian3 &boundsMin, const Cartesian3 &boundsMax)
+{
+    Cartesian3 extent = boundsMax - boundsMin;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+#endif // BOUNDS_H
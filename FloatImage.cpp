@@ -0,0 +1,126 @@
+#include "FloatImage.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include "RGBAImage.h"
+
+//The pixels are read and written straight from and to the array, three floats to a pixel
+static_assert(sizeof(Cartesian3) == 3 * sizeof(float), "Cartesian3 must be three packed floats");
+
+namespace
+{
+    bool littleEndian()
+    {
+        uint32_t one = 1;
+        unsigned char firstByte;
+        std::memcpy(&firstByte, &one, 1);
+        return firstByte == 1;
+    }
+
+    void swapBytes(float *values, size_t count)
+    {
+        unsigned char *bytes = reinterpret_cast<unsigned char *>(values);
+        for (size_t i = 0; i < count; i++, bytes += 4)
+        {
+            std::swap(bytes[0], bytes[3]);
+            std::swap(bytes[1], bytes[2]);
+        }
+    }
+}
+
+FloatImage::FloatImage()
+{
+    width = 0;
+    height = 0;
+}
+
+bool FloatImage::Resize(long width, long height)
+{
+    if (width < 0 || width > MAX_IMAGE_DIMENSION || height < 0 || height > MAX_IMAGE_DIMENSION)
+    {
+        std::cout << "Cannot handle image of size " << width << " x " << height << std::endl;
+        return false;
+    }
+    pixels.assign(width * height, Cartesian3(0.0f, 0.0f, 0.0f));
+    this->width = width;
+    this->height = height;
+    return true;
+}
+
+Cartesian3 *FloatImage::operator [](long row)
+{
+    return pixels.data() + row * width;
+}
+
+const Cartesian3 *FloatImage::operator [](long row) const
+{
+    return pixels.data() + row * width;
+}
+
+bool FloatImage::ReadPFM(std::istream &inStream)
+{
+    std::string code;
+    inStream >> code;
+    if (code != "PF" && code != "Pf")
+    {
+        std::cerr << "Float stream did not start with PFM code (PF or Pf)" << std::endl;
+        return false;
+    }
+    int channels = code == "PF" ? 3 : 1;
+
+    long newWidth, newHeight;
+    float scale;
+    inStream >> newWidth >> newHeight >> scale;
+    if (inStream.fail() || scale == 0.0f)
+    {
+        std::cerr << "Float stream had a malformed PFM header" << std::endl;
+        return false;
+    }
+    if (newWidth < 1 || newHeight < 1 || !Resize(newWidth, newHeight))
+        return false;
+
+    //Exactly one whitespace character separates the header from the pixels
+    inStream.get();
+
+    std::vector<float> values(channels * width * height);
+    if (!inStream.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(float)))
+    {
+        std::cerr << "Float stream ended before all " << width << " x " << height << " pixels were read" << std::endl;
+        return false;
+    }
+    //The sign of the scale gives the byte order of the file
+    if ((scale < 0.0f) != littleEndian())
+        swapBytes(values.data(), values.size());
+
+    for (long pixel = 0; pixel < width * height; pixel++)
+        if (channels == 3)
+            pixels[pixel] = Cartesian3(values[3 * pixel], values[3 * pixel + 1], values[3 * pixel + 2]);
+        else
+            pixels[pixel] = Cartesian3(values[pixel], values[pixel], values[pixel]);
+    return true;
+}
+
+void FloatImage::WritePFM(std::ostream &outStream) const
+{
+    outStream << PFMHeader(width, height);
+    outStream.write(reinterpret_cast<const char *>(pixels.data()), pixels.size() * sizeof(Cartesian3));
+}
+
+bool FloatImage::IsPFMFilename(const std::string &filename)
+{
+    std::string extension = filename.size() >= 4 ? filename.substr(filename.size() - 4) : "";
+    for (char &c : extension)
+        c = std::tolower(c);
+    return extension == ".pfm";
+}
+
+std::string FloatImage::PFMHeader(long width, long height)
+{
+    //The scale is negative for little endian files, positive for big endian ones
+    std::ostringstream header;
+    header << "PF\n" << width << " " << height << "\n" << (littleEndian() ? "-1.0" : "1.0") << "\n";
+    return header.str();
+}
@@ -0,0 +1,39 @@
+#ifndef FLOATIMAGE_H
+#define FLOATIMAGE_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include "Cartesian3.h"
+
+//An image of linear RGB radiance, one float per channel, as the tracers produce it before tone mapping
+//Rows go from the bottom of the image up, like the frame buffer (and like PFM files, so they are read and written as they are)
+class FloatImage
+{
+public:
+    long width, height;
+    std::vector<Cartesian3> pixels;
+
+    FloatImage();
+
+    //Resizes the image, setting every pixel to black. Returns false for sizes it cannot handle
+    bool Resize(long width, long height);
+
+    //Start of a row, which can then be indexed by column
+    Cartesian3 *operator [](long row);
+    const Cartesian3 *operator [](long row) const;
+
+    //PFM (portable float map) files: a short text header, then the pixels as raw 32 bit floats
+    //Reads colour (PF) and greyscale (Pf) files of either byte order; the stream must be opened in binary mode
+    bool ReadPFM(std::istream &inStream);
+    //Writes a colour PFM in the byte order of this machine, with the pixels in a single write
+    void WritePFM(std::ostream &outStream) const;
+
+    //Whether a filename has the .pfm extension (in any case)
+    static bool IsPFMFilename(const std::string &filename);
+
+    //The header WritePFM() writes, after which the pixels follow row by row, 12 bytes each
+    static std::string PFMHeader(long width, long height);
+};
+
+#endif // FLOATIMAGE_H
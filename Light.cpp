@@ -23,3 +23,12 @@ Homogeneous4 Light::GetPositionCenter()
     return lightPosition;
 }
 
+Homogeneous4 Light::GetPositionSample(float u, float v)
+{
+    if (type != Area)
+        return lightPosition;
+
+    //The centre is half of each edge in from the corner
+    return lightPosition.Point() + tangent1.Vector() * (u - 0.5f) + tangent2.Vector() * (v - 0.5f);
+}
+
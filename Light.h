@@ -42,10 +42,14 @@ private:
 public:
     Light(LightType type,Homogeneous4 color,Homogeneous4 pos, Homogeneous4 dir, Homogeneous4 tan1, Homogeneous4 tan2);
     Homogeneous4 GetPositionCenter();
+    //Point at (u, v) across an area light, where u and v run from 0 to 1 along its two edges
+    //Other lights only have the one position, so they always return their centre
+    Homogeneous4 GetPositionSample(float u, float v);
 
     bool enabled;
 
     inline Homogeneous4 GetColor(){return lightColor;}
+    inline LightType GetType(){return type;}
 
 };
 
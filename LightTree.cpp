@@ -0,0 +1,123 @@
+#include "LightTree.h"
+#include "Bounds.h"
+#include <algorithm>
+
+//Largest float below 1, to keep u inside [0, 1)
+#define LARGEST_BELOW_ONE 0.99999994f
+
+void LightTree::build(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax, const std::vector<float> &power)
+{
+    nodes.clear();
+    lights.clear();
+    centroids.assign(boundsMin.size(), Cartesian3());
+
+    for (unsigned int i = 0; i < boundsMin.size(); i++)
+    {
+        if (!(power[i] > 0.0f))
+            continue;
+        lights.push_back(i);
+        centroids[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+    }
+
+    if (lights.empty())
+        return;
+
+    //A binary tree with one light per leaf has exactly 2n - 1 nodes for n lights
+    nodes.resize(2 * lights.size() - 1);
+    subdivide(0, 0, lights.size(), boundsMin, boundsMax, power);
+    std::vector<Cartesian3>().swap(centroids);
+}
+
+void LightTree::subdivide(unsigned int nodeIndex, unsigned int first, unsigned int count, const std::vector<Cartesian3> &boundsMin,
+                          const std::vector<Cartesian3> &boundsMax, const std::vector<float> &power)
+{
+    Node &node = nodes[nodeIndex];
+
+    if (count == 1)
+    {
+        node.boundsMin = boundsMin[lights[first]];
+        node.boundsMax = boundsMax[lights[first]];
+        node.power = power[lights[first]];
+        node.rightOrLight = first;
+        node.leaf = true;
+        return;
+    }
+
+    //Split at the median along the axis over which the centres of the lights are most spread out
+    Cartesian3 centroidMin = centroids[lights[first]];
+    Cartesian3 centroidMax = centroidMin;
+    for (unsigned int i = first + 1; i < first + count; i++)
+    {
+        centroidMin = minimum(centroidMin, centroids[lights[i]]);
+        centroidMax = maximum(centroidMax, centroids[lights[i]]);
+    }
+    Cartesian3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent.x)
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+
+    unsigned int half = count / 2;
+    std::nth_element(lights.begin() + first, lights.begin() + first + half, lights.begin() + first + count,
+                     [this, axis](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    //Nodes are laid out depth first: the left child's subtree follows the node, and the right child's follows that
+    //A subtree over k lights has 2k - 1 nodes, which gives where the right child goes
+    unsigned int left = nodeIndex + 1;
+    unsigned int right = left + 2 * half - 1;
+    subdivide(left, first, half, boundsMin, boundsMax, power);
+    subdivide(right, first + half, count - half, boundsMin, boundsMax, power);
+
+    node.boundsMin = minimum(nodes[left].boundsMin, nodes[right].boundsMin);
+    node.boundsMax = maximum(nodes[left].boundsMax, nodes[right].boundsMax);
+    node.power = nodes[left].power + nodes[right].power;
+    node.rightOrLight = right;
+    node.leaf = false;
+}
+
+bool LightTree::empty() const
+{
+    return nodes.empty();
+}
+
+unsigned int LightTree::sample(const Cartesian3 &point, float u, float &pdf) const
+{
+    pdf = 1.0f;
+    unsigned int n = 0;
+    while (!nodes[n].leaf)
+    {
+        unsigned int left = n + 1;
+        unsigned int right = nodes[n].rightOrLight;
+
+        //Go left or right in proportion to how much each side could light the point
+        float importanceLeft = importance(nodes[left], point);
+        float importanceRight = importance(nodes[right], point);
+        float probabilityLeft = importanceLeft / (importanceLeft + importanceRight);
+
+        //u is then stretched back over [0, 1) for the next level down
+        if (u < probabilityLeft)
+        {
+            pdf *= probabilityLeft;
+            u = u / probabilityLeft;
+            n = left;
+        }
+        else
+        {
+            pdf *= 1.0f - probabilityLeft;
+            u = (u - probabilityLeft) / (1.0f - probabilityLeft);
+            n = right;
+        }
+        //Rounding may have pushed u up to 1
+        u = std::min(u, LARGEST_BELOW_ONE);
+    }
+    return lights[nodes[n].rightOrLight];
+}
+
+float LightTree::importance(const Node &node, const Cartesian3 &point) const
+{
+    //Distance from the point to the nearest point of the box, which is 0 inside it
+    Cartesian3 outside = maximum(maximum(node.boundsMin - point, point - node.boundsMax), Cartesian3(0.0f, 0.0f, 0.0f));
+    float distanceSquared = outside.dot(outside);
+    return node.power / (1.0f + distanceSquared);
+}
@@ -0,0 +1,59 @@
+#ifndef LIGHTTREE_H
+#define LIGHTTREE_H
+
+#include <vector>
+#include "Cartesian3.h"
+
+//A BVH over the lights of a scene, for picking which few lights to shade a point with when there are too many to try them all
+//Every node holds the total power of the lights below it, and sample() walks down from the root choosing each time
+//between the two children by how much light they could bring to the point: their power over (1 + d^2), d being
+//the distance to their box, as in the attenuation of the Phong model. Choosing a light only visits one node per level,
+//so it costs O(log n) for n lights, and bright, nearby lights are chosen most often
+class LightTree
+{
+public:
+    struct Node
+    {
+        Cartesian3 boundsMin;
+        Cartesian3 boundsMax;
+        //Sum of the power of every light below the node
+        float power;
+
+        //Interior node: index of the right child (the left child always comes straight after the node itself)
+        //Leaf node: index of its light in lights
+        unsigned int rightOrLight;
+
+        bool leaf;
+    };
+
+    std::vector<Node> nodes;
+
+    //Indices of the lights, in the order the leaves refer to them
+    std::vector<unsigned int> lights;
+
+    //Builds the tree over a list of lights, each with the box around it and its power (e.g. the brightness of its colour)
+    //Lights with no power can never be chosen, so they are left out
+    void build(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax, const std::vector<float> &power);
+
+    bool empty() const;
+
+    //Chooses a light to shade point with, given a uniform random number u in [0, 1)
+    //(u is rescaled and reused at each level, which leaves plenty of precision for the few levels of even thousands of lights)
+    //Returns its index in the lists the tree was built from, and sets pdf to the probability of having chosen it
+    //Must not be called on an empty tree
+    unsigned int sample(const Cartesian3 &point, float u, float &pdf) const;
+
+private:
+    //Centroids of the boxes, only needed while building
+    std::vector<Cartesian3> centroids;
+
+    //Fills in a node over lights[first, first + count) and everything below it
+    //Median splits halve the lights at every level, so the recursion is only O(log n) deep
+    void subdivide(unsigned int nodeIndex, unsigned int first, unsigned int count, const std::vector<Cartesian3> &boundsMin,
+                   const std::vector<Cartesian3> &boundsMax, const std::vector<float> &power);
+
+    //How much light a node could bring to a point, up to a constant factor
+    float importance(const Node &node, const Cartesian3 &point) const;
+};
+
+#endif // LIGHTTREE_H
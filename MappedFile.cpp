@@ -0,0 +1,112 @@
+#include "MappedFile.h"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP
+#endif
+
+MappedFile::MappedFile()
+{
+    contents = nullptr;
+    length = 0;
+    mapped = false;
+    opened = false;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+
+#ifdef MAPPED_FILE_MMAP
+    int descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0)
+    {
+        ::close(descriptor);
+        return false;
+    }
+
+    //mmap refuses empty files, which are simply open with no contents
+    bool empty = S_ISREG(status.st_mode) && status.st_size == 0;
+    if (status.st_size > 0)
+    {
+        void *address = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address != MAP_FAILED)
+        {
+            //Readers go through the file once from front to back
+            madvise(address, size_t(status.st_size), MADV_SEQUENTIAL);
+            contents = static_cast<const char *>(address);
+            length = size_t(status.st_size);
+            mapped = true;
+        }
+    }
+    ::close(descriptor);
+
+    if (mapped || empty)
+    {
+        opened = true;
+        return true;
+    }
+    //Some files (on special filesystems, for instance) cannot be mapped, so fall back on reading them
+#endif
+
+    std::ifstream file(filename.c_str(), std::ios::binary);
+    if (!file.good())
+        return false;
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    if (fileSize < 0)
+        return false;
+    file.seekg(0, std::ios::beg);
+
+    buffer.resize(size_t(fileSize));
+    if (!file.read(buffer.data(), fileSize))
+    {
+        buffer.clear();
+        return false;
+    }
+    contents = buffer.data();
+    length = buffer.size();
+    opened = true;
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef MAPPED_FILE_MMAP
+    if (mapped)
+        munmap(const_cast<char *>(contents), length);
+#endif
+    contents = nullptr;
+    length = 0;
+    mapped = false;
+    opened = false;
+    std::vector<char>().swap(buffer);
+}
+
+bool MappedFile::isOpen() const
+{
+    return opened;
+}
+
+const char *MappedFile::data() const
+{
+    return contents;
+}
+
+size_t MappedFile::size() const
+{
+    return length;
+}
@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+//Read-only view of a whole file
+//Where the system supports it the file is memory mapped, so the pages are read in by the
+//kernel as they are touched and nothing is copied; elsewhere the file is read into memory
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    //Closes any file already open. Returns false if the file cannot be opened or read
+    bool open(const std::string &filename);
+    void close();
+
+    bool isOpen() const;
+    const char *data() const;
+    size_t size() const;
+
+private:
+    const char *contents;
+    size_t length;
+    bool mapped;
+    bool opened;
+
+    //Holds the contents when the file could not be mapped
+    std::vector<char> buffer;
+};
+
+#endif // MAPPEDFILE_H
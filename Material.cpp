@@ -7,6 +7,30 @@
 
 #include "Material.h"
 #include <string>
+#include "FloatImage.h"
+#include "ToneMapper.h"
+
+namespace
+{
+    //Reads a texture from a PPM (ASCII or binary) or, going by the filename, a PFM file
+    //PFM textures hold linear values, which are gamma corrected into 8 bits the same way as the ray traced image
+    bool readTexture(std::istream &textureStream, const std::string &filename, RGBAImage &texture)
+    {
+        if (!FloatImage::IsPFMFilename(filename))
+            return texture.ReadPPM(textureStream);
+
+        FloatImage values;
+        if (!values.ReadPFM(textureStream) || !texture.Resize(values.width, values.height))
+            return false;
+        //PFM rows run bottom to top, PPM rows (and so textures) top to bottom
+        ToneMapper toneMapper;
+        for (long row = 0; row < values.height; row++)
+            for (long col = 0; col < values.width; col++)
+                texture[row][col] = toneMapper.map(values[values.height - 1 - row][col]);
+        return true;
+    }
+}
+
 Material::Material(Cartesian3 ambient,Cartesian3 diffuse,Cartesian3 specular,Cartesian3 emissive,float shininess,std::istream &textureStream)
 {
     this->ambient = ambient;
@@ -139,12 +163,13 @@ std::vector<Material*> Material::readMaterials(std::istream &materialStream)
         {
             std::string filename = "";
             materialStream >> filename;
-            std::ifstream textureFile(filename.c_str());
+            std::ifstream textureFile(filename.c_str(), std::ios::binary);
             if(!textureFile.good()){
                 std::cout << "Problem reading texture " << filename << " for the material " << m->name << std::endl;
             }else{
                 m->texture = new RGBAImage();
-                m->texture->ReadPPM(textureFile);
+                readTexture(textureFile, filename, *m->texture);
+                m->textureFilename = filename;
             }
         }
     } // not eof
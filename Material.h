@@ -40,6 +40,8 @@ public:
     float indexOfRefraction;
     float transparency;
     RGBAImage *texture;
+    //File the texture was read from (empty if there is none), so that caches can tell when it changes
+    std::string textureFilename;
     bool isLight();
     Material();
     Material(Cartesian3 ambient,Cartesian3 diffuse,Cartesian3 specular,Cartesian3 emissive,float shininess,std::istream &textureStream);
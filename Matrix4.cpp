@@ -10,6 +10,7 @@
 #include "Matrix4.h"
 #include "Quaternion.h"
 #include <limits>
+#include <algorithm>
 #include <math.h>
 
 // constructor - default to the zero matrix
@@ -157,6 +158,60 @@ Matrix4 Matrix4::transpose() const
     return transposeMatrix;
     } // transpose()
 
+// matrix inverse, by Gauss-Jordan elimination with partial pivoting
+Matrix4 Matrix4::inverse() const
+    { // inverse()
+    // work on a copy, turning it into the identity while the same row
+    // operations turn an identity matrix into the inverse
+    Matrix4 working(*this);
+    Matrix4 inverseMatrix;
+    inverseMatrix.SetIdentity();
+
+    for (int col = 0; col < 4; col++)
+        { // per column
+        // pick the largest entry left in the column as the pivot, for stability
+        int pivot = col;
+        for (int row = col + 1; row < 4; row++)
+            if (fabs(working.coordinates[row][col]) > fabs(working.coordinates[pivot][col]))
+                pivot = row;
+
+        // a zero column means the matrix is singular
+        if (working.coordinates[pivot][col] == 0.0f)
+            return Matrix4();
+
+        // swap the pivot row into place
+        for (int entry = 0; entry < 4; entry++)
+            { // swap
+            std::swap(working.coordinates[col][entry], working.coordinates[pivot][entry]);
+            std::swap(inverseMatrix.coordinates[col][entry], inverseMatrix.coordinates[pivot][entry]);
+            } // swap
+
+        // scale the pivot row so the pivot is 1
+        float scale = 1.0f / working.coordinates[col][col];
+        for (int entry = 0; entry < 4; entry++)
+            { // scale
+            working.coordinates[col][entry] *= scale;
+            inverseMatrix.coordinates[col][entry] *= scale;
+            } // scale
+
+        // and clear the column in every other row
+        for (int row = 0; row < 4; row++)
+            { // per row
+            if (row == col)
+                continue;
+            float factor = working.coordinates[row][col];
+            for (int entry = 0; entry < 4; entry++)
+                { // subtract
+                working.coordinates[row][entry] -= factor * working.coordinates[col][entry];
+                inverseMatrix.coordinates[row][entry] -= factor * inverseMatrix.coordinates[col][entry];
+                } // subtract
+            } // per row
+        } // per column
+
+    // return the result
+    return inverseMatrix;
+    } // inverse()
+
 // returns a column-major array of 16 values
 // for use with OpenGL
 columnMajorMatrix Matrix4::columnMajor() const
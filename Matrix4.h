@@ -78,6 +78,9 @@ class Matrix4
     
     // matrix transpose
     Matrix4 transpose() const;
+
+    // matrix inverse (the zero matrix if there is none)
+    Matrix4 inverse() const;
     
     // returns a column-major array of 16 values
     // for use with OpenGL
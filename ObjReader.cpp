@@ -0,0 +1,502 @@
+#include "ObjReader.h"
+#include "MappedFile.h"
+#include <charconv>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+    //Files are only split into chunks at least this big, smaller ones are not worth another thread
+    const size_t MINIMUM_CHUNK_BYTES = 1 << 20;
+
+    //A corner with no texture coordinate or normal
+    const unsigned int NO_INDEX = UINT_MAX;
+    //A corner index that is zero, relative (negative) or unreadable, which drops the face
+    const unsigned int BAD_INDEX = UINT_MAX - 1;
+
+    //Set in a face's corner count once the face has been dropped
+    const unsigned int DROPPED_FACE = 0x80000000u;
+
+    //A run of faces in one chunk that all go to the same model
+    struct Segment
+    {
+        //The material a usemtl line switched to, or null for the faces at the start of a chunk
+        Material *material;
+        unsigned int firstFace;
+
+        //Counted once the whole file has been parsed
+        unsigned int validFaces;
+        unsigned int validCorners;
+        unsigned int facesWithoutNormals;
+
+        //Where the faces go: which model, from which face and corner, and the first generated normal they use
+        unsigned int model;
+        unsigned int firstSlot;
+        unsigned int firstCornerSlot;
+        unsigned int firstGeneratedNormal;
+    };
+
+    //Everything parsed from one chunk of the file, with indices already converted to 0-based
+    struct Chunk
+    {
+        const char *begin;
+        const char *end;
+
+        //x y z per vertex and normal (normals already unit length), u v per texture coordinate
+        std::vector<float> vertices;
+        std::vector<float> normals;
+        std::vector<float> textureCoords;
+
+        //Corner indices of all the faces one after the other, and the number of corners in each face
+        std::vector<unsigned int> cornerVertices;
+        std::vector<unsigned int> cornerNormals;
+        std::vector<unsigned int> cornerTexCoords;
+        std::vector<unsigned int> faceSizes;
+
+        std::vector<Segment> segments;
+        bool needsDefaultTexCoord;
+
+        //Where this chunk's vertices, normals and texture coordinates start in the whole file's arrays
+        size_t firstVertex;
+        size_t firstNormal;
+        size_t firstTexCoord;
+    };
+
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline const char *skipBlanks(const char *p, const char *end)
+    {
+        while (p < end && isBlank(*p))
+            p++;
+        return p;
+    }
+
+    //Reads a float, leaving 0 if there is none
+    inline const char *readFloat(const char *p, const char *end, float &value)
+    {
+        p = skipBlanks(p, end);
+        //from_chars does not accept a leading +, although the stream operators do
+        if (p < end && *p == '+')
+            p++;
+        value = 0.0f;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec == std::errc::invalid_argument)
+            return p;
+        return result.ptr;
+    }
+
+    //Reads a 1-based index and gives it 0-based
+    inline const char *readIndex(const char *p, const char *end, unsigned int &index)
+    {
+        bool negative = p < end && *p == '-';
+        if (negative)
+            p++;
+
+        const char *digits = p;
+        unsigned long long value = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+        {
+            value = std::min<unsigned long long>(value * 10 + (*p - '0'), BAD_INDEX);
+            p++;
+        }
+
+        if (p == digits || negative || value == 0 || value >= BAD_INDEX)
+            index = BAD_INDEX;
+        else
+            index = static_cast<unsigned int>(value - 1);
+        return p;
+    }
+
+    //True if the line continues with word followed by a blank
+    inline bool startsWith(const char *p, const char *end, const char *word, size_t length)
+    {
+        return size_t(end - p) > length && std::memcmp(p, word, length) == 0 && isBlank(p[length]);
+    }
+
+    void parseFace(Chunk &chunk, const char *p, const char *end)
+    {
+        size_t firstCorner = chunk.cornerVertices.size();
+        while (true)
+        {
+            p = skipBlanks(p, end);
+            if (p == end)
+                break;
+
+            unsigned int vertex, texCoord = NO_INDEX, normal = NO_INDEX;
+            p = readIndex(p, end, vertex);
+            if (p < end && *p == '/')
+            {
+                p++;
+                if (p < end && *p != '/')
+                    p = readIndex(p, end, texCoord);
+                if (p < end && *p == '/')
+                    p = readIndex(p + 1, end, normal);
+            }
+            //Anything else stuck to the corner means we have misread it
+            if (p < end && !isBlank(*p))
+            {
+                vertex = BAD_INDEX;
+                while (p < end && !isBlank(*p))
+                    p++;
+            }
+
+            chunk.cornerVertices.push_back(vertex);
+            chunk.cornerTexCoords.push_back(texCoord);
+            chunk.cornerNormals.push_back(normal);
+        }
+
+        //As in the stream reader, anything with fewer than three corners is not a face at all
+        size_t corners = chunk.cornerVertices.size() - firstCorner;
+        if (corners < 3)
+        {
+            chunk.cornerVertices.resize(firstCorner);
+            chunk.cornerTexCoords.resize(firstCorner);
+            chunk.cornerNormals.resize(firstCorner);
+            return;
+        }
+        chunk.faceSizes.push_back(static_cast<unsigned int>(corners));
+    }
+
+    void parseChunk(Chunk &chunk, const std::unordered_map<std::string, Material *> &materials)
+    {
+        chunk.segments.push_back(Segment{nullptr, 0, 0, 0, 0, 0, 0, 0, 0});
+        chunk.needsDefaultTexCoord = false;
+
+        const char *line = chunk.begin;
+        while (line < chunk.end)
+        {
+            const char *end = static_cast<const char *>(std::memchr(line, '\n', size_t(chunk.end - line)));
+            if (end == nullptr)
+                end = chunk.end;
+
+            const char *p = skipBlanks(line, end);
+            if (p < end)
+                switch (*p)
+                {
+                case 'v':
+                    if (startsWith(p, end, "v", 1))
+                    {
+                        float xyz[3];
+                        p = readFloat(p + 1, end, xyz[0]);
+                        p = readFloat(p, end, xyz[1]);
+                        readFloat(p, end, xyz[2]);
+                        chunk.vertices.insert(chunk.vertices.end(), xyz, xyz + 3);
+                    }
+                    else if (startsWith(p, end, "vn", 2))
+                    {
+                        Cartesian3 normal;
+                        p = readFloat(p + 2, end, normal.x);
+                        p = readFloat(p, end, normal.y);
+                        readFloat(p, end, normal.z);
+                        normal = normal.unit();
+                        chunk.normals.insert(chunk.normals.end(), {normal.x, normal.y, normal.z});
+                    }
+                    else if (startsWith(p, end, "vt", 2))
+                    {
+                        float uv[2];
+                        p = readFloat(p + 2, end, uv[0]);
+                        readFloat(p, end, uv[1]);
+                        chunk.textureCoords.insert(chunk.textureCoords.end(), uv, uv + 2);
+                    }
+                    break;
+
+                case 'f':
+                    if (startsWith(p, end, "f", 1))
+                        parseFace(chunk, p + 1, end);
+                    break;
+
+                case 'u':
+                    if (startsWith(p, end, "usemtl", 6))
+                    {
+                        const char *name = skipBlanks(p + 6, end);
+                        const char *nameEnd = name;
+                        while (nameEnd < end && !isBlank(*nameEnd))
+                            nameEnd++;
+
+                        //Names not in the material file are ignored, as the stream reader does
+                        auto material = materials.find(std::string(name, nameEnd));
+                        if (material != materials.end())
+                            chunk.segments.push_back(Segment{material->second, static_cast<unsigned int>(chunk.faceSizes.size()), 0, 0, 0, 0, 0, 0, 0});
+                    }
+                    break;
+
+                default:
+                    break;
+                }
+
+            line = end + 1;
+        }
+    }
+
+    //Drops the faces with indices out of range, and counts what each segment needs
+    unsigned int checkChunk(Chunk &chunk, size_t vertexCount, size_t normalCount, size_t texCoordCount)
+    {
+        unsigned int dropped = 0;
+        size_t corner = 0;
+        unsigned int segment = 0;
+        for (unsigned int face = 0; face < chunk.faceSizes.size(); face++)
+        {
+            while (segment + 1 < chunk.segments.size() && chunk.segments[segment + 1].firstFace <= face)
+                segment++;
+
+            unsigned int size = chunk.faceSizes[face];
+            bool valid = true;
+            bool hasNormals = true;
+            bool hasTexCoords = true;
+            for (unsigned int i = 0; i < size; i++)
+            {
+                unsigned int vertex = chunk.cornerVertices[corner + i];
+                unsigned int normal = chunk.cornerNormals[corner + i];
+                unsigned int texCoord = chunk.cornerTexCoords[corner + i];
+                if (vertex >= vertexCount)
+                    valid = false;
+                if (normal == NO_INDEX)
+                    hasNormals = false;
+                else if (normal >= normalCount)
+                    valid = false;
+                if (texCoord == NO_INDEX)
+                    hasTexCoords = false;
+                else if (texCoord >= texCoordCount)
+                    valid = false;
+            }
+            corner += size;
+
+            if (!valid)
+            {
+                chunk.faceSizes[face] |= DROPPED_FACE;
+                dropped++;
+                continue;
+            }
+            chunk.segments[segment].validFaces++;
+            chunk.segments[segment].validCorners += size;
+            if (!hasNormals)
+                chunk.segments[segment].facesWithoutNormals++;
+            if (!hasTexCoords)
+                chunk.needsDefaultTexCoord = true;
+        }
+        return dropped;
+    }
+
+    //Moves the chunk's vertices, normals and texture coordinates to their places in the whole file's arrays
+    void copyAttributes(Chunk &chunk, std::vector<Cartesian3> &vertices, std::vector<Cartesian3> &normals, std::vector<Cartesian3> &textureCoords)
+    {
+        for (size_t i = 0; i < chunk.vertices.size() / 3; i++)
+            vertices[chunk.firstVertex + i] = Cartesian3(chunk.vertices[3 * i], chunk.vertices[3 * i + 1], chunk.vertices[3 * i + 2]);
+        for (size_t i = 0; i < chunk.normals.size() / 3; i++)
+            normals[chunk.firstNormal + i] = Cartesian3(chunk.normals[3 * i], chunk.normals[3 * i + 1], chunk.normals[3 * i + 2]);
+        for (size_t i = 0; i < chunk.textureCoords.size() / 2; i++)
+            textureCoords[chunk.firstTexCoord + i] = Cartesian3(chunk.textureCoords[2 * i], chunk.textureCoords[2 * i + 1], 0.0f);
+
+        //Free the chunk's copy straight away, which keeps the peak memory down on big files
+        std::vector<float>().swap(chunk.vertices);
+        std::vector<float>().swap(chunk.normals);
+        std::vector<float>().swap(chunk.textureCoords);
+    }
+
+    //Moves the chunk's faces into their models, generating the normals that are missing
+    void copyFaces(Chunk &chunk, std::vector<ThreeDModel> &models, const std::vector<Cartesian3> &vertices,
+                   std::vector<Cartesian3> &normals, unsigned int defaultTexCoord)
+    {
+        size_t corner = 0;
+        unsigned int segment = 0;
+        unsigned int slot = chunk.segments[0].firstSlot;
+        unsigned int cornerSlot = chunk.segments[0].firstCornerSlot;
+        unsigned int generatedNormal = chunk.segments[0].firstGeneratedNormal;
+        for (unsigned int face = 0; face < chunk.faceSizes.size(); face++)
+        {
+            while (segment + 1 < chunk.segments.size() && chunk.segments[segment + 1].firstFace <= face)
+            {
+                segment++;
+                slot = chunk.segments[segment].firstSlot;
+                cornerSlot = chunk.segments[segment].firstCornerSlot;
+                generatedNormal = chunk.segments[segment].firstGeneratedNormal;
+            }
+
+            unsigned int size = chunk.faceSizes[face];
+            if (size & DROPPED_FACE)
+            {
+                corner += size & ~DROPPED_FACE;
+                continue;
+            }
+
+            ThreeDModel &model = models[chunk.segments[segment].model];
+            unsigned int *faceVertices = &model.cornerVertices[cornerSlot];
+            unsigned int *faceNormals = &model.cornerNormals[cornerSlot];
+            unsigned int *faceTexCoords = &model.cornerTexCoords[cornerSlot];
+            std::copy(&chunk.cornerVertices[corner], &chunk.cornerVertices[corner] + size, faceVertices);
+            std::copy(&chunk.cornerNormals[corner], &chunk.cornerNormals[corner] + size, faceNormals);
+            std::copy(&chunk.cornerTexCoords[corner], &chunk.cornerTexCoords[corner] + size, faceTexCoords);
+            cornerSlot += size;
+            model.faceOffsets[++slot] = cornerSlot;
+
+            if (std::find(faceNormals, faceNormals + size, NO_INDEX) != faceNormals + size)
+            {
+                const Cartesian3 &a = vertices[faceVertices[0]];
+                normals[generatedNormal] = (vertices[faceVertices[1]] - a).cross(vertices[faceVertices[2]] - a).unit();
+                std::fill(faceNormals, faceNormals + size, generatedNormal);
+                generatedNormal++;
+            }
+            std::replace(faceTexCoords, faceTexCoords + size, NO_INDEX, defaultTexCoord);
+
+            corner += size;
+        }
+
+        std::vector<unsigned int>().swap(chunk.cornerVertices);
+        std::vector<unsigned int>().swap(chunk.cornerNormals);
+        std::vector<unsigned int>().swap(chunk.cornerTexCoords);
+    }
+}
+
+ObjReader::ObjReader(unsigned int threadCount)
+    : pool(threadCount)
+{
+    bytes = 0;
+    dropped = 0;
+}
+
+unsigned int ObjReader::threadCount() const
+{
+    return pool.size();
+}
+
+size_t ObjReader::bytesRead() const
+{
+    return bytes;
+}
+
+unsigned int ObjReader::facesDropped() const
+{
+    return dropped;
+}
+
+std::vector<ThreeDModel> ObjReader::read(const std::string &geometryFilename, std::istream &materialStream)
+{
+    std::vector<ThreeDModel> models;
+    bytes = 0;
+    dropped = 0;
+
+    MappedFile file;
+    if (!file.open(geometryFilename))
+        return models;
+    bytes = file.size();
+
+    //Where two materials share a name, the stream reader uses the first
+    std::vector<Material *> materialList = Material::readMaterials(materialStream);
+    std::unordered_map<std::string, Material *> materials;
+    for (Material *material : materialList)
+        materials.emplace(material->name, material);
+
+    //Cut the file into a few chunks per thread, so that the work can still be balanced
+    //when some parts of the file are slower to parse than others (faces rather than vertices)
+    const char *begin = file.data();
+    const char *end = begin + file.size();
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(file.size() / MINIMUM_CHUNK_BYTES, pool.size() * 4));
+    std::vector<Chunk> chunks(chunkCount);
+    const char *chunkBegin = begin;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        //Each chunk ends just after the first line break past its share of the file
+        const char *chunkEnd = end;
+        if (i + 1 < chunkCount)
+        {
+            chunkEnd = std::max(chunkBegin, begin + file.size() * (i + 1) / chunkCount);
+            const char *lineBreak = static_cast<const char *>(std::memchr(chunkEnd, '\n', size_t(end - chunkEnd)));
+            chunkEnd = lineBreak ? lineBreak + 1 : end;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    pool.run(static_cast<unsigned int>(chunkCount), [&](unsigned int task, unsigned int)
+    {
+        parseChunk(chunks[task], materials);
+    });
+    //Nothing refers to the text any more, so let its pages go before the models are built
+    file.close();
+
+    //Indices in the file count from the start of the file, so each chunk's attributes simply follow the last
+    size_t vertexCount = 0, normalCount = 0, texCoordCount = 0;
+    for (Chunk &chunk : chunks)
+    {
+        chunk.firstVertex = vertexCount;
+        chunk.firstNormal = normalCount;
+        chunk.firstTexCoord = texCoordCount;
+        vertexCount += chunk.vertices.size() / 3;
+        normalCount += chunk.normals.size() / 3;
+        texCoordCount += chunk.textureCoords.size() / 2;
+    }
+
+    std::vector<unsigned int> chunkDropped(chunkCount);
+    pool.run(static_cast<unsigned int>(chunkCount), [&](unsigned int task, unsigned int)
+    {
+        chunkDropped[task] = checkChunk(chunks[task], vertexCount, normalCount, texCoordCount);
+    });
+
+    //Hand out the models in file order. As in the stream reader, the first usemtl names the material of
+    //the faces read so far, and every later one starts a new model
+    models.resize(1);
+    std::vector<unsigned int> modelFaces(1, 0);
+    std::vector<unsigned int> modelCorners(1, 0);
+    size_t generatedNormals = 0;
+    bool needsDefaultTexCoord = false;
+    for (size_t i = 0; i < chunkCount; i++)
+    {
+        dropped += chunkDropped[i];
+        needsDefaultTexCoord = needsDefaultTexCoord || chunks[i].needsDefaultTexCoord;
+        for (Segment &segment : chunks[i].segments)
+        {
+            if (segment.material != nullptr)
+            {
+                if (models.back().material != nullptr)
+                {
+                    models.emplace_back();
+                    modelFaces.push_back(0);
+                    modelCorners.push_back(0);
+                }
+                models.back().material = segment.material;
+            }
+            segment.model = static_cast<unsigned int>(models.size() - 1);
+            segment.firstSlot = modelFaces.back();
+            segment.firstCornerSlot = modelCorners.back();
+            segment.firstGeneratedNormal = static_cast<unsigned int>(normalCount + generatedNormals);
+            modelFaces.back() += segment.validFaces;
+            modelCorners.back() += segment.validCorners;
+            generatedNormals += segment.facesWithoutNormals;
+        }
+    }
+
+    //The vertex data is shared by all the models, with the generated normals and the
+    //default texture coordinate at the end
+    std::shared_ptr<MeshAttributes> attributes = std::make_shared<MeshAttributes>();
+    attributes->vertices.resize(vertexCount);
+    attributes->normals.resize(normalCount + generatedNormals);
+    attributes->textureCoords.resize(texCoordCount + (needsDefaultTexCoord ? 1 : 0));
+    unsigned int defaultTexCoord = static_cast<unsigned int>(texCoordCount);
+
+    for (size_t model = 0; model < models.size(); model++)
+    {
+        models[model].attributes = attributes;
+        models[model].faceOffsets.resize(modelFaces[model] + 1);
+        models[model].cornerVertices.resize(modelCorners[model]);
+        models[model].cornerNormals.resize(modelCorners[model]);
+        models[model].cornerTexCoords.resize(modelCorners[model]);
+    }
+
+    pool.run(static_cast<unsigned int>(chunkCount), [&](unsigned int task, unsigned int)
+    {
+        copyAttributes(chunks[task], attributes->vertices, attributes->normals, attributes->textureCoords);
+    });
+    //Generating a normal may need a vertex from any chunk, so this waits for all of them to be copied
+    pool.run(static_cast<unsigned int>(chunkCount), [&](unsigned int task, unsigned int)
+    {
+        copyFaces(chunks[task], models, attributes->vertices, attributes->normals, defaultTexCoord);
+    });
+
+    return models;
+}
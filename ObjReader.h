@@ -0,0 +1,39 @@
+#ifndef OBJREADER_H
+#define OBJREADER_H
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include "ThreeDModel.h"
+#include "ThreadPool.h"
+
+//Fast reader for Wavefront .obj files, giving the same models as ThreeDModel::ReadObjectStreamMaterial
+//The file is memory mapped and cut into chunks at line boundaries. The chunks are parsed in parallel
+//into flat arrays by a hand written scanner (std::from_chars for the numbers), with no allocation
+//per line, and are then stitched together in file order.
+//
+//It also takes the faces the stream reader cannot: corners written as "v", "v/t" or "v//n" as well as
+//"v/t/n". Corners with no texture coordinate get (0, 0) and faces with no normals get their flat face
+//normal. Faces that refer to vertices, normals or texture coordinates that do not exist are dropped
+class ObjReader
+{
+public:
+    //threadCount 0 means one thread per hardware thread
+    explicit ObjReader(unsigned int threadCount = 0);
+    unsigned int threadCount() const;
+
+    //Reads the geometry file and splits it into one model per material, as ReadObjectStreamMaterial does
+    //Returns no models at all if the file cannot be read
+    std::vector<ThreeDModel> read(const std::string &geometryFilename, std::istream &materialStream);
+
+    //Size of the file last read, and how many of its faces had to be dropped
+    size_t bytesRead() const;
+    unsigned int facesDropped() const;
+
+private:
+    ThreadPool pool;
+    size_t bytes;
+    unsigned int dropped;
+};
+
+#endif // OBJREADER_H
@@ -0,0 +1,29 @@
+#include "PixelRandom.h"
+
+namespace
+{
+    //Integer hash (PCG output permutation), good enough to decorrelate neighbouring seeds
+    unsigned int hash(unsigned int value)
+    {
+        unsigned int state = value * 747796405u + 2891336453u;
+        unsigned int word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+}
+
+PixelRandom::PixelRandom(unsigned int x, unsigned int y, unsigned int sample)
+{
+    state = hash(x ^ hash(y ^ hash(sample)));
+}
+
+PixelRandom::PixelRandom()
+{
+    state = 0;
+}
+
+float PixelRandom::next()
+{
+    state = hash(state);
+    //The top 24 bits fill a float's mantissa exactly, so the result never rounds up to 1
+    return (state >> 8) * (1.0f / 16777216.0f);
+}
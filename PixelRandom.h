@@ -0,0 +1,21 @@
+#ifndef PIXELRANDOM_H
+#define PIXELRANDOM_H
+
+//Small, fast random number generator seeded from a pixel and a sample number
+//The sequence depends only on the seed, not on which thread renders the pixel or in which order,
+//so progressive renders are repeatable no matter how the tiles were scheduled
+class PixelRandom
+{
+public:
+    PixelRandom(unsigned int x, unsigned int y, unsigned int sample);
+    //Unseeded, for arrays that are assigned seeded generators afterwards
+    PixelRandom();
+
+    //Uniform in [0, 1)
+    float next();
+
+private:
+    unsigned int state;
+};
+
+#endif // PIXELRANDOM_H
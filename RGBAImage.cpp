@@ -12,11 +12,10 @@
 //  
 //  A minimal class for an image in single-byte RGBA format
 //  Optimized for simplicity, not speed or memory
-//  With read/write for ASCII RGBA files
+//  With read/write for ASCII and binary RGBA files
 //  
 ///////////////////////////////////////////////////
 
-#define MAX_IMAGE_DIMENSION 4096
 #define MAX_LINE_LENGTH 1024
 
 #include <stdlib.h>
@@ -24,6 +23,7 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include "string.h"
 
 #include "RGBAImage.h"
@@ -73,10 +73,14 @@ bool RGBAImage::Resize(long Width, long Height)
         // release the old pointer
         free(block);
 
-    // use calloc() to allocate & zero memory
-    block = static_cast<RGBAValue *>(calloc(static_cast<unsigned long>(Height * Width), sizeof (RGBAValue)));
+    // use calloc() to allocate & zero memory (in size_t, as large images run to gigabytes)
+    block = static_cast<RGBAValue *>(calloc(static_cast<size_t>(Height) * static_cast<size_t>(Width), sizeof (RGBAValue)));
     if (block == nullptr)
+        { // out of memory
+        std::cout << "Not enough memory for an image of size " << Width << " x " << Height << std::endl;
+        width = height = 0;
         return false;
+        } // out of memory
 
     // now that it's reallocated and copied, reset the parameters
     height = Height;
@@ -178,9 +182,10 @@ bool RGBAImage::ReadPPM(std::istream &inStream)
     inStream.getline(lineBuffer, MAX_LINE_LENGTH);
     
     // check for magic number (file code) in first two characters
-    if (strcmp(lineBuffer,"P3") != 0)
+    bool binary = strcmp(lineBuffer,"P6") == 0;
+    if (strcmp(lineBuffer,"P3") != 0 && !binary)
         { // failed read
-        std::cerr << "RGBA stream did not start with PPM code (P3)" << std::endl;
+        std::cerr << "RGBA stream did not start with PPM code (P3 or P6)" << std::endl;
         return false;
         } // failed read
 
@@ -194,6 +199,12 @@ bool RGBAImage::ReadPPM(std::istream &inStream)
     // check the byte max value
     int maxValue;
     inStream >> maxValue;
+
+    if (inStream.fail())
+        { // failure
+        std::cerr << "RGBA stream had a malformed PPM header" << std::endl;
+        return false;
+        } // failure
     
     if (maxValue != 255)
         { // failure
@@ -210,12 +221,35 @@ bool RGBAImage::ReadPPM(std::istream &inStream)
         } // bad sizes
 
     // resize the image
-    Resize(newWidth, newHeight);
+    if (!Resize(newWidth, newHeight))
+        return false;
 
-    // loop through pixels, reading them:
-    for (int row = 0; row < height; row++)
-        for (int col = 0; col < width; col++)       
-            inStream >> (*this)[row][col];
+    if (binary)
+        { // binary
+        // exactly one whitespace character separates the header from the pixels
+        inStream.get();
+
+        // read all of the pixels at once, then spread them out to four bytes each
+        std::vector<unsigned char> bytes(3 * width * height);
+        if (!inStream.read(reinterpret_cast<char *>(bytes.data()), bytes.size()))
+            { // short read
+            std::cerr << "RGBA stream ended before all " << width << " x " << height << " pixels were read" << std::endl;
+            return false;
+            } // short read
+        for (long pixel = 0; pixel < width * height; pixel++)
+            {
+            block[pixel].red = bytes[3 * pixel];
+            block[pixel].green = bytes[3 * pixel + 1];
+            block[pixel].blue = bytes[3 * pixel + 2];
+            }
+        } // binary
+    else
+        { // ASCII
+        // loop through pixels, reading them:
+        for (int row = 0; row < height; row++)
+            for (int col = 0; col < width; col++)
+                inStream >> (*this)[row][col];
+        } // ASCII
 
     // done
     return true;
@@ -244,6 +278,31 @@ void RGBAImage::WritePPM(std::ostream &outStream)
         } // row
     } // WritePPMFile()
 
+// binary file write routine
+void RGBAImage::WriteBinaryPPM(std::ostream &outStream) const
+    { // WriteBinaryPPM()
+    // print out header information
+    outStream << BinaryPPMHeader(width, height);
+
+    // pack the pixels into three bytes each, then write them in one go
+    std::vector<unsigned char> bytes(3 * width * height);
+    for (long pixel = 0; pixel < width * height; pixel++)
+        {
+        bytes[3 * pixel] = block[pixel].red;
+        bytes[3 * pixel + 1] = block[pixel].green;
+        bytes[3 * pixel + 2] = block[pixel].blue;
+        }
+    outStream.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    } // WriteBinaryPPM()
+
+// header for binary files, which must end with a single whitespace character
+std::string RGBAImage::BinaryPPMHeader(long Width, long Height)
+    { // BinaryPPMHeader()
+    std::ostringstream header;
+    header << "P6\n" << Width << " " << Height << "\n" << 255 << "\n";
+    return header.str();
+    } // BinaryPPMHeader()
+
 void RGBAImage::clear(RGBAValue color){
     for (int row = 0; row < height; row++)
         { // row
@@ -0,0 +1,10 @@
+# Headless batch renderer: same tracer as the window, but no Qt and no display
+TEMPLATE = app
+TARGET = RaytraceBatch
+CONFIG += console
+CONFIG -= qt app_bundle
+INCLUDEPATH += .
+
+include(RaytraceCore.pri)
+
+SOURCES += batch.cpp
@@ -0,0 +1,13 @@
+# Render benchmark over the scenes in objects/, prints CSV for tracking performance over time
+TEMPLATE = app
+TARGET = RaytraceBench
+CONFIG += console
+CONFIG -= qt app_bundle
+INCLUDEPATH += .
+
+# benchmarks are only meaningful with optimisation on
+CONFIG += release
+
+include(RaytraceCore.pri)
+
+SOURCES += benchmark.cpp
@@ -0,0 +1,81 @@
+# Sources shared by every target: geometry, scene, materials and the tracer itself
+# None of these need Qt, so the batch renderer can be built without it
+
+INCLUDEPATH += $$PWD
+
+# the SIMD triangle blocks are over-aligned, which std::vector only honours from C++17
+CONFIG += c++17
+
+# the tracer renders tiles on its own thread pool (see TileScheduler)
+CONFIG += thread
+QMAKE_CXXFLAGS+= -Wall
+
+# ThreeDModel::Render() still calls into OpenGL
+win32{
+    LIBS += -lopengl32
+}
+unix:!macx{
+    LIBS += -lGL
+}
+
+HEADERS += $$PWD/BandedRender.h \
+           $$PWD/Bounds.h \
+           $$PWD/BVH.h \
+           $$PWD/Cartesian3.h \
+           $$PWD/FloatImage.h \
+           $$PWD/Homogeneous4.h \
+           $$PWD/Light.h \
+           $$PWD/LightTree.h \
+           $$PWD/MappedFile.h \
+           $$PWD/Material.h \
+           $$PWD/Matrix4.h \
+           $$PWD/ObjReader.h \
+           $$PWD/PixelRandom.h \
+           $$PWD/Quaternion.h \
+           $$PWD/Ray.h \
+           $$PWD/Raytracer.h \
+           $$PWD/RenderJob.h \
+           $$PWD/RenderParameters.h \
+           $$PWD/RGBAImage.h \
+           $$PWD/RGBAValue.h \
+           $$PWD/Scene.h \
+           $$PWD/SceneCache.h \
+           $$PWD/ThreadPool.h \
+           $$PWD/ThreeDModel.h \
+           $$PWD/TileScheduler.h \
+           $$PWD/TileWriter.h \
+           $$PWD/ToneMapper.h \
+           $$PWD/TopLevelBVH.h \
+           $$PWD/Triangle.h \
+           $$PWD/TriangleBlock.h \
+           $$PWD/TripleBuffer.h
+SOURCES += $$PWD/BandedRender.cpp \
+           $$PWD/BVH.cpp \
+           $$PWD/Cartesian3.cpp \
+           $$PWD/FloatImage.cpp \
+           $$PWD/Homogeneous4.cpp \
+           $$PWD/Light.cpp \
+           $$PWD/LightTree.cpp \
+           $$PWD/MappedFile.cpp \
+           $$PWD/Material.cpp \
+           $$PWD/Matrix4.cpp \
+           $$PWD/ObjReader.cpp \
+           $$PWD/PixelRandom.cpp \
+           $$PWD/Quaternion.cpp \
+           $$PWD/Ray.cpp \
+           $$PWD/Raytracer.cpp \
+           $$PWD/RenderJob.cpp \
+           $$PWD/RenderParameters.cpp \
+           $$PWD/RGBAImage.cpp \
+           $$PWD/RGBAValue.cpp \
+           $$PWD/Scene.cpp \
+           $$PWD/SceneCache.cpp \
+           $$PWD/ThreadPool.cpp \
+           $$PWD/ThreeDModel.cpp \
+           $$PWD/TileScheduler.cpp \
+           $$PWD/TileWriter.cpp \
+           $$PWD/ToneMapper.cpp \
+           $$PWD/TopLevelBVH.cpp \
+           $$PWD/Triangle.cpp \
+           $$PWD/TriangleBlock.cpp \
+           $$PWD/TripleBuffer.cpp
@@ -20,8 +20,6 @@
 #define RAYTRACE_RENDER_WIDGET_H
 
 #include <vector>
-#include <mutex>
-#include <thread>
 
 // include the relevant QT headers
 #include <QOpenGLWidget>
@@ -32,6 +30,7 @@
 #include "RenderParameters.h"
 #include "Scene.h"
 #include "Ray.h"
+#include "RenderJob.h"
 
 // class for a render widget with arcball linked to an external arcball widget
 class RaytraceRenderWidget : public QOpenGLWidget										
@@ -44,8 +43,8 @@ class RaytraceRenderWidget : public QOpenGLWidget
 	// the render parameters to use
 	RenderParameters *renderParameters;
 
-	// An image to use as a framebuffer
-	RGBAImage frameBuffer;
+	// size of the image to ray trace, in pixels
+	int imageWidth, imageHeight;
 
 	public:
 	// constructor
@@ -66,16 +65,20 @@ class RaytraceRenderWidget : public QOpenGLWidget
     //Routine that generates the image
     void Raytrace();
 
-    void RaytraceThread();
-    std::thread raytracingThread;
-    void forceRepaint();
+    //Called whenever the render parameters change: once Raytrace has been pressed,
+    //the render under way is abandoned and a new one started with the new parameters
+    void ParametersChanged();
+
+    //Called when only the exposure or tone mapping changes, which redraws the image without tracing it again
+    void ToneChanged();
 
-    Scene *scene;
+    void forceRepaint();
 
-    Ray calculateRay(int pixelx, int pixely, bool perspective);
-    Ray calculateSecondaryRay(Homogeneous4 origin, Homogeneous4 destination);
+    //Does the actual tracing on its own thread, and hands over finished images for display
+    RenderJob *renderJob;
 
-    Homogeneous4 calculateLightforRay(Ray ray, int depth);
+    //Set once Raytrace has been pressed, after which the image follows the parameters
+    bool raytraceRequested;
 
 	protected:
 	// called when OpenGL context is set up
@@ -93,6 +96,8 @@ class RaytraceRenderWidget : public QOpenGLWidget
     private:
 
 	signals:
+	// emitted (from the render thread) when a render ends, completed is false if it was abandoned
+	void RaytraceFinished(bool completed);
 	// these are general purpose signals, which scale the drag to 
 	// the notional unit sphere and pass it to the controller for handling
 	void BeginScaledDrag(int whichButton, float x, float y);
@@ -0,0 +1,824 @@
+#include <math.h>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include "Raytracer.h"
+
+#define N_BOUNCES 5
+#define TERMINATION_FACTOR 0.35f
+
+//Upper limit on renderParameters->lightSamples, which sizes the stratum tables in lightVisibility()
+#define MAX_LIGHT_SAMPLES 256
+//Area lights stop being sampled after this many shadow rays if all of them agree,
+//since the point is then almost certainly fully lit or fully in shadow rather than in a penumbra
+#define SHADOW_EARLY_OUT 4
+
+//Longest path the path tracer follows; Russian roulette ends almost all of them long before this
+#define MAX_PATH_LENGTH 64
+//Samples every pixel gets before adaptive sampling starts to judge which ones need more
+#define ADAPTIVE_BASE_SAMPLES 4
+//Reflected and refracted rays are not traced once they could add less than this to the pixel (one step of an 8 bit channel, before gamma)
+#define PATH_WEIGHT_CUTOFF (1.0f / 255.0f)
+
+namespace
+{
+    //Product of two colours, channel by channel
+    Cartesian3 modulate(const Cartesian3 &a, const Cartesian3 &b)
+    {
+        return Cartesian3(a.x * b.x, a.y * b.y, a.z * b.z);
+    }
+
+    //Random direction in the hemisphere about the unit vector normal, with probability density cos(theta) / pi,
+    //from uniform random numbers u1 and u2: a uniform point on the unit disc, projected up onto the hemisphere
+    Cartesian3 cosineSampleHemisphere(const Cartesian3 &normal, float u1, float u2)
+    {
+        //Any two directions at right angles to the normal and to each other
+        Cartesian3 helper = fabs(normal.x) > 0.9f ? Cartesian3(0.0f, 1.0f, 0.0f) : Cartesian3(1.0f, 0.0f, 0.0f);
+        Cartesian3 tangent = normal.cross(helper).unit();
+        Cartesian3 bitangent = normal.cross(tangent);
+
+        float radius = sqrt(u1);
+        float angle = 2.0f * float(M_PI) * u2;
+        return (radius * cos(angle)) * tangent + (radius * sin(angle)) * bitangent + sqrt(std::max(0.0f, 1.0f - u1)) * normal;
+    }
+
+    //Fraction of the light arriving along direction at a smooth transparent surface that it reflects, by the Fresnel equations
+    //(averaged over the two polarisations), setting refracted to the direction the rest carries on in
+    //normal is the unit normal on the side the light arrives from, and eta the index of refraction of that side over the other
+    //Returns 1 for total internal reflection, when none of the light can get through (refracted is then left alone)
+    float fresnelRefract(const Cartesian3 &direction, const Cartesian3 &normal, float eta, Cartesian3 &refracted)
+    {
+        float cosIncident = std::min(1.0f, std::max(0.0f, -normal.dot(direction)));
+        //Snell's law
+        float sinTransmittedSquared = eta * eta * (1.0f - cosIncident * cosIncident);
+        if (sinTransmittedSquared >= 1.0f)
+            return 1.0f;
+        float cosTransmitted = sqrt(1.0f - sinTransmittedSquared);
+
+        refracted = ((eta * direction) + ((eta * cosIncident - cosTransmitted) * normal)).unit();
+
+        float perpendicular = (eta * cosIncident - cosTransmitted) / (eta * cosIncident + cosTransmitted);
+        float parallel = (cosIncident - eta * cosTransmitted) / (cosIncident + eta * cosTransmitted);
+        return 0.5f * (perpendicular * perpendicular + parallel * parallel);
+    }
+
+    //Index of refraction of a material, treating unset (0) ones as air
+    float refractiveIndex(const Material *material)
+    {
+        return material->indexOfRefraction > 0 ? material->indexOfRefraction : 1.0f;
+    }
+}
+
+Raytracer::Raytracer(Scene *newScene, RenderParameters *newRenderParameters, RGBAImage *newFrameBuffer)
+{
+    scene = newScene;
+    renderParameters = newRenderParameters;
+    frameBuffer = newFrameBuffer;
+    samplesTaken = 0;
+    cancelRequested = false;
+    samplingLights = false;
+    samplesTraced = 0;
+    setWindow(0, 0, 0, 0);
+    setTone(0.0f, false);
+    drawnExposure = 0.0f;
+    drawnToneMapping = false;
+}
+
+void Raytracer::Render()
+{
+    frameBuffer->clear(RGBAValue(0.0f, 0.0f, 0.0f, 1.0f));
+
+    //Shading happens in scene space, where the lights already are (the camera is applied to the rays instead)
+    lightPositions.clear();
+    lightColours.clear();
+    lightAreaVectors.clear();
+    std::vector<Cartesian3> lightsMin, lightsMax;
+    std::vector<float> lightPowers;
+    for (unsigned int i = 0; i < renderParameters->lights.size(); i++)
+    {
+        Light *light = renderParameters->lights[i];
+        lightPositions.push_back(light->GetPositionCenter());
+        lightColours.push_back(light->GetColor());
+
+        //Box around the light, from its corners (which all sit at the centre for a point light)
+        Cartesian3 boundsMin = light->GetPositionSample(0.0f, 0.0f).Point();
+        Cartesian3 boundsMax = boundsMin;
+        for (int corner = 1; corner < 4; corner++)
+        {
+            Cartesian3 p = light->GetPositionSample(corner & 1, corner >> 1).Point();
+            boundsMin = Cartesian3(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+            boundsMax = Cartesian3(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+        }
+        Cartesian3 corner = light->GetPositionSample(0.0f, 0.0f).Point();
+        Cartesian3 edge1 = light->GetPositionSample(1.0f, 0.0f).Point() - corner;
+        Cartesian3 edge2 = light->GetPositionSample(0.0f, 1.0f).Point() - corner;
+        lightAreaVectors.push_back(edge1.cross(edge2));
+
+        lightsMin.push_back(boundsMin);
+        lightsMax.push_back(boundsMax);
+        Cartesian3 colour = light->GetColor().Vector();
+        lightPowers.push_back((colour.x + colour.y + colour.z) / 3.0f);
+    }
+
+    //With only a few lights, every one of them is used, as it always was
+    lightTree.build(lightsMin, lightsMax, lightPowers);
+    samplingLights = renderParameters->sampledLights > 0 && lightPositions.size() > renderParameters->sampledLights && !lightTree.empty();
+
+    unsigned int nPixels = frameBuffer->width * frameBuffer->height;
+    accumulation.assign(nPixels, Cartesian3(0.0f, 0.0f, 0.0f));
+    sampleCounts.assign(nPixels, 0);
+    activePixels.assign(nPixels, 1);
+    brightnessSums.assign(nPixels, 0.0f);
+    brightnessSquares.assign(nPixels, 0.0f);
+    samplesTaken = 0;
+    samplesTraced = 0;
+
+    scheduler.setThreadCount(renderParameters->threadCount);
+    auto start = std::chrono::steady_clock::now();
+
+    //One pass per sample, so the whole image sharpens together rather than tile by tile
+    for (unsigned int sample = 0; sample < renderParameters->sampleBudget; sample++)
+    {
+        //The tone settings are read once per pass, so the whole pass is drawn with the same ones
+        ToneMapper toneMapper = currentToneMapper();
+        scheduler.run(frameBuffer->width, frameBuffer->height, renderParameters->tileSize,
+                      [this, sample, &toneMapper](const TileScheduler::Tile &tile) { renderTile(tile, sample, toneMapper); });
+        if (cancelRequested)
+            break;
+        samplesTaken = sample + 1;
+        if (passCompleted)
+            passCompleted();
+
+        //Once every pixel has its first few samples, adaptive sampling only carries on with the ones that still need more
+        if (renderParameters->adaptiveThreshold > 0.0f && sample + 1 >= ADAPTIVE_BASE_SAMPLES && updateActivePixels() == 0)
+            break;
+
+        std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+        if (renderParameters->timeBudget > 0.0f && elapsed.count() >= renderParameters->timeBudget)
+            break;
+    }
+}
+
+void Raytracer::setWindow(long wholeWidth, long wholeHeight, long windowX, long windowY)
+{
+    this->wholeWidth = wholeWidth;
+    this->wholeHeight = wholeHeight;
+    this->windowX = windowX;
+    this->windowY = windowY;
+}
+
+float Raytracer::imageWidth() const
+{
+    return wholeWidth > 0 ? wholeWidth : frameBuffer->width;
+}
+
+float Raytracer::imageHeight() const
+{
+    return wholeWidth > 0 ? wholeHeight : frameBuffer->height;
+}
+
+void Raytracer::setTone(float exposure, bool toneMapping)
+{
+    this->exposure = exposure;
+    this->toneMapping = toneMapping;
+}
+
+bool Raytracer::toneChanged() const
+{
+    return exposure != drawnExposure || toneMapping != drawnToneMapping;
+}
+
+ToneMapper Raytracer::currentToneMapper()
+{
+    drawnExposure = exposure;
+    drawnToneMapping = toneMapping;
+    return ToneMapper(drawnExposure, drawnToneMapping ? ToneMapper::Reinhard : ToneMapper::Clip);
+}
+
+bool Raytracer::toneMap()
+{
+    //Nothing to draw if the last render never got as far as clearing the buffers, e.g. because it was cancelled straight away
+    if (accumulation.size() != (unsigned int) (frameBuffer->width * frameBuffer->height))
+        return false;
+
+    //A lookup and a few multiplies per channel, quick enough not to need the render threads
+    TileScheduler::Tile wholeImage;
+    wholeImage.x = 0;
+    wholeImage.y = 0;
+    wholeImage.width = frameBuffer->width;
+    wholeImage.height = frameBuffer->height;
+    toneMapTile(wholeImage, currentToneMapper());
+    return true;
+}
+
+void Raytracer::toneMapTile(const TileScheduler::Tile &tile, const ToneMapper &toneMapper)
+{
+    for (int j = tile.y; j < tile.y + tile.height; j++)
+    {
+        for (int i = tile.x; i < tile.x + tile.width; i++)
+        {
+            unsigned int pixel = j * frameBuffer->width + i;
+            //Pixels without a sample yet stay black
+            if (sampleCounts[pixel] == 0)
+                (*frameBuffer)[j][i] = RGBAValue(0.0f, 0.0f, 0.0f, 255.0f);
+            else
+                (*frameBuffer)[j][i] = toneMapper.map(accumulation[pixel] * (1.0f / sampleCounts[pixel]));
+        }
+    }
+}
+
+void Raytracer::radiance(const TileScheduler::Tile &tile, FloatImage &image) const
+{
+    for (int j = tile.y; j < tile.y + tile.height; j++)
+    {
+        for (int i = tile.x; i < tile.x + tile.width; i++)
+        {
+            unsigned int pixel = j * frameBuffer->width + i;
+            if (sampleCounts[pixel] == 0)
+                image[j][i] = Cartesian3(0.0f, 0.0f, 0.0f);
+            else
+                image[j][i] = accumulation[pixel] * (1.0f / sampleCounts[pixel]);
+        }
+    }
+}
+
+unsigned int Raytracer::updateActivePixels()
+{
+    int width = frameBuffer->width;
+    int height = frameBuffer->height;
+    float threshold = renderParameters->adaptiveThreshold;
+
+    //A pixel has settled once the standard error of its mean brightness, sqrt(variance / n), is below the threshold
+    std::vector<unsigned char> noisy(width * height, 0);
+    for (int pixel = 0; pixel < width * height; pixel++)
+    {
+        unsigned int n = sampleCounts[pixel];
+        if (!activePixels[pixel] || n < 2)
+            continue;
+        float mean = brightnessSums[pixel] / n;
+        float variance = std::max(0.0f, (brightnessSquares[pixel] - n * mean * mean) / (n - 1));
+        noisy[pixel] = variance > threshold * threshold * n;
+    }
+
+    //Noisy pixels keep their neighbours sampling too: an edge that the first samples of one pixel happened to miss
+    //usually shows up as noise next door, and stopping one side of an edge early leaves it jagged
+    unsigned int nActive = 0;
+    for (int j = 0; j < height; j++)
+    {
+        for (int i = 0; i < width; i++)
+        {
+            int pixel = j * width + i;
+            bool active = false;
+            for (int y = std::max(0, j - 1); y <= std::min(height - 1, j + 1) && !active; y++)
+                for (int x = std::max(0, i - 1); x <= std::min(width - 1, i + 1) && !active; x++)
+                    active = noisy[y * width + x];
+
+            //Pixels that have settled stay settled, whatever their neighbours do later
+            activePixels[pixel] = active && activePixels[pixel];
+            nActive += activePixels[pixel];
+        }
+    }
+    return nActive;
+}
+
+void Raytracer::renderTile(const TileScheduler::Tile &tile, unsigned int sample, const ToneMapper &toneMapper)
+{
+    if (cancelRequested)
+        return;
+
+    bool adaptive = renderParameters->adaptiveThreshold > 0.0f;
+    unsigned long long tileSamples = 0;
+
+    //Packets only help primary rays, which start out coherent
+    bool packets = renderParameters->packetTracing && renderParameters->bvhEnabled;
+
+    for (int j = tile.y; j < tile.y + tile.height; j++)
+    {
+        for (int i = tile.x; i < tile.x + tile.width; i += BVH_PACKET_SIZE)
+        {
+            //Trace a run of neighbouring pixels together, falling back to single rays at the edge of the tile
+            int nPixels = std::min(BVH_PACKET_SIZE, tile.x + tile.width - i);
+            Ray rays[BVH_PACKET_SIZE];
+            Scene::CollisionInfo hits[BVH_PACKET_SIZE];
+            //Each pixel sample draws its jitter first, then its shadow samples, from its own stream
+            PixelRandom randoms[BVH_PACKET_SIZE];
+
+            //Only pixels that adaptive sampling has not yet finished with get another sample
+            int traced[BVH_PACKET_SIZE];
+            int nTraced = 0;
+            for (int k = 0; k < nPixels; k++)
+                if (activePixels[j * frameBuffer->width + i + k])
+                    traced[nTraced++] = k;
+            tileSamples += nTraced;
+
+            for (int t = 0; t < nTraced; t++)
+            {
+                int k = traced[t];
+                randoms[t] = PixelRandom(i + k + windowX, j + windowY, sample);
+
+                //The first sample goes through the corner of the pixel as it always has, later ones are jittered across it
+                float dx = 0.0f, dy = 0.0f;
+                if (sample > 0)
+                {
+                    dx = randoms[t].next();
+                    dy = randoms[t].next();
+                }
+                rays[t] = calculateRay(i + k + windowX + dx, j + windowY + dy, !renderParameters->orthoProjection);
+            }
+
+            if (packets && nTraced == BVH_PACKET_SIZE)
+                scene->closestTriangles(rays, hits);
+            else
+                for (int t = 0; t < nTraced; t++)
+                    hits[t] = scene->closestTriangle(rays[t]);
+
+            for (int t = 0; t < nTraced; t++)
+            {
+                int k = traced[t];
+                Homogeneous4 sampleColour = calculatePixelColour(rays[t], hits[t], i + k + windowX, j + windowY, randoms[t]);
+
+                unsigned int pixel = j * frameBuffer->width + i + k;
+                accumulation[pixel] = accumulation[pixel] + Cartesian3(sampleColour.x, sampleColour.y, sampleColour.z);
+                sampleCounts[pixel]++;
+
+                if (adaptive)
+                {
+                    float value = toneMapper.brightness(Cartesian3(sampleColour.x, sampleColour.y, sampleColour.z));
+                    brightnessSums[pixel] += value;
+                    brightnessSquares[pixel] += value * value;
+                }
+            }
+        }
+    }
+
+    //Every pixel is written, sampled this pass or not, since the frame buffer may be a different image from last pass
+    toneMapTile(tile, toneMapper);
+    if (tileCompleted)
+        tileCompleted(tile);
+
+    samplesTraced += tileSamples;
+}
+
+Homogeneous4 Raytracer::calculatePixelColour(const Ray &ray, const Scene::CollisionInfo &hitInfo, int i, int j, PixelRandom &random)
+{
+    Homogeneous4 color;
+
+    if (renderParameters->pathTracing)
+    {
+        color = tracePath(ray, hitInfo, random);
+    }
+
+    else if (renderParameters->reflectionEnabled)
+    {
+        color = calculateLightforHit(ray, hitInfo, N_BOUNCES, 1.0f, random);
+    }
+
+    else
+    {
+        if(hitInfo.t > 0)
+        {
+            Triangle transformed;
+            const Triangle &tri = scene->hitTriangle(hitInfo, transformed);
+            color = {1.0f, 1.0f, 1.0f};
+            //We calculate o from our t, since o = origin + t*direction
+            Cartesian3 o = ray.origin + (hitInfo.t*ray.direction);
+            //Barycentric coordinates come straight from the intersection test
+            const Cartesian3 &barycentricCoords = hitInfo.barycentric;
+
+            if (renderParameters->interpolationRendering)
+            {
+                //Perform barycentric interpolation if enabled, showing the normal as the camera sees it
+                color = (tri.normals[0] * barycentricCoords.x) + (tri.normals[1] * barycentricCoords.y) + (tri.normals[2] * barycentricCoords.z);
+                color = scene->modelView * color;
+                color.x = abs(color.x);
+                color.y = abs(color.y);
+                color.z = abs(color.z);
+
+            }
+
+            if (renderParameters->phongEnabled)
+            {
+                Homogeneous4 finalColour;
+                //Loop through every light, and calculate the Phong lighting
+                unsigned int nLights = lightChoiceCount();
+                for (unsigned int c = 0; c < nLights; c++)
+                {
+                        LightChoice choice = chooseLight(o, c, random);
+                        unsigned int i = choice.light;
+
+                        //Light position in scene space, like the triangles
+                        const Homogeneous4 &lightPosition = lightPositions[i];
+                        const Homogeneous4 &lightColour = lightColours[i];
+
+                        Homogeneous4 phong = choice.weight * tri.calculatePhong(lightPosition, lightColour, scene->eye, barycentricCoords, 1.0f);
+
+                        finalColour = finalColour + phong;
+
+                }
+                //Set the colour to be the colour calculated using Blinn-Phong
+                color = finalColour;
+
+             }
+
+            if(renderParameters->shadowsEnabled)
+            {
+                Homogeneous4 finalColour;
+                //Loop through every light, and calculate the Phong lighting
+                unsigned int nLights = lightChoiceCount();
+                for (unsigned int c = 0; c < nLights; c++)
+                {
+                        LightChoice choice = chooseLight(o, c, random);
+                        unsigned int i = choice.light;
+
+                        //Light position in scene space, like the triangles
+                        const Homogeneous4 &lightPosition = lightPositions[i];
+                        const Homogeneous4 &lightColour = lightColours[i];
+
+                        //Experimenting with normals
+                        const Homogeneous4 &pNormal = tri.normals[0];
+                        const Homogeneous4 &qNormal = tri.normals[1];
+                        const Homogeneous4 &rNormal = tri.normals[2];
+
+                        Homogeneous4 normal = (pNormal * barycentricCoords.x) + (qNormal * barycentricCoords.y) + (rNormal * barycentricCoords.z);
+
+                        //Adjust the starting position of secondary Ray to prevent the ray intersecting with itself and causing shadow acne
+                        float epsilon = 0.001;
+                        Cartesian3 secondaryRayOrigin = o + (epsilon * Cartesian3 (normal.x, normal.y, normal.z));
+
+                        //How much of the light can be seen from o: partly visible area lights give soft shadows
+                        float visibility = lightVisibility(secondaryRayOrigin, i, random);
+
+                        Homogeneous4 phong = choice.weight * tri.calculatePhong(lightPosition, lightColour, scene->eye, barycentricCoords, visibility);
+                        finalColour = finalColour + phong;
+
+                }
+
+                //Set the colour to be the colour calculated using Blinn-Phong
+                color = finalColour;
+
+            }
+
+
+        }
+
+        else
+        {
+            color = {i/imageHeight(), j/imageWidth(), 0};
+
+        }
+
+    }
+
+    return color;
+}
+
+Homogeneous4 Raytracer::calculateLightforRay(const Ray &ray, int depth, float pathWeight, PixelRandom &random)
+{
+    return calculateLightforHit(ray, scene->closestTriangle(ray), depth, pathWeight, random);
+}
+
+Homogeneous4 Raytracer::calculateLightforHit(const Ray &ray, const Scene::CollisionInfo &hitInfo, int depth, float pathWeight, PixelRandom &random)
+{
+    Homogeneous4 colour;
+
+    if (hitInfo.t > 0)
+    {
+        Triangle transformed;
+        const Triangle &tri = scene->hitTriangle(hitInfo, transformed);
+
+        //We calculate o from our t, since o = origin + t*direction
+        Cartesian3 o = ray.origin + (hitInfo.t*ray.direction);
+        //Barycentric coordinates come straight from the intersection test
+        const Cartesian3 &barycentricCoords = hitInfo.barycentric;
+
+        //Calculate normal vector using barycentric coordinates
+        Cartesian3 oNormal= (tri.normals[0].Vector() * barycentricCoords.x) + (tri.normals[1].Vector() * barycentricCoords.y) + (tri.normals[2].Vector() * barycentricCoords.z);
+
+        //If we reach here, then the bounce limit is reached, or the reflectivity value is 0
+        //Either way, we calculate the colour of the point using standard methods (Blinn-Phong, shadows etc)
+        Homogeneous4 finalColour;
+        unsigned int nLights = lightChoiceCount();
+        for (unsigned int c = 0; c < nLights; c++)
+        {
+            LightChoice choice = chooseLight(o, c, random);
+            unsigned int i = choice.light;
+
+            //Light position in scene space, like the triangles
+            const Homogeneous4 &lightPosition = lightPositions[i];
+            const Homogeneous4 &lightColour = lightColours[i];
+
+            //Experimenting with normals
+            const Homogeneous4 &pNormal = tri.normals[0];
+            const Homogeneous4 &qNormal = tri.normals[1];
+            const Homogeneous4 &rNormal = tri.normals[2];
+
+            Cartesian3 normal = ((pNormal * barycentricCoords.x) + (qNormal * barycentricCoords.y) + (rNormal * barycentricCoords.z)).Vector();
+
+            //Adjust the starting position of secondary Ray to prevent the ray intersecting with itself and causing shadow acne
+            float epsilon = 0.001;
+            Cartesian3 secondaryRayOrigin = o + (epsilon * normal);
+
+            //How much of the light can be seen from o: partly visible area lights give soft shadows
+            float visibility = lightVisibility(secondaryRayOrigin, i, random);
+
+            //Calculate colour using Blinn-Phong Model
+            Homogeneous4 phong = choice.weight * tri.calculatePhong(lightPosition, lightColour, scene->eye, barycentricCoords, visibility);
+            finalColour = finalColour + phong;
+        }
+
+        //The light leaving the surface is shared between its own shading, a mirror reflection and, for transparent materials,
+        //light refracted through it, of which the Fresnel equations send some into the reflection instead
+        const Material *material = tri.shared_material;
+        float transparency = material->transparency;
+        float reflectWeight = (1 - transparency) * material->reflectivity;
+        float refractWeight = 0;
+
+        //The normal on the side the ray came from, which is the inside of a transparent object on the way out of it
+        Cartesian3 facingNormal = oNormal.dot(ray.direction) < 0 ? oNormal : -1.0f * oNormal;
+
+        Ray refractedRay;
+        if (transparency > 0)
+        {
+            Cartesian3 unitNormal = facingNormal.unit();
+            float ior = refractiveIndex(material);
+            float eta = oNormal.dot(ray.direction) < 0 ? 1.0f / ior : ior;
+            float fresnel = fresnelRefract(ray.direction, unitNormal, eta, refractedRay.direction);
+
+            reflectWeight += transparency * fresnel;
+            refractWeight = transparency * (1 - fresnel);
+
+            //Displaced to the far side of the surface
+            float epsilon = 0.001;
+            refractedRay.origin = o - (epsilon * unitNormal);
+        }
+
+        //We bounce if: the max number of bounces is not reached, and the surface has any sort of reflection
+        if (reflectWeight > 0 || refractWeight > 0)
+        {
+
+            Ray reflectedRay;
+            //Displace by a small amount to prevent acne
+            float epsilon = 0.001;
+            reflectedRay.origin = o + (epsilon * facingNormal);
+
+            //Calculate reflected ray direction using the formula r = r - 2(n.r)n
+            reflectedRay.direction = (ray.direction - (2*(ray.direction.dot(oNormal) * oNormal))).unit();
+
+            //Calculate current colour given its reflectiveness and transparency
+
+            finalColour = (((1 - transparency) * (1 - material->reflectivity)) * finalColour);
+            Homogeneous4 rayColour;
+
+            if(depth != 0)
+            {
+                //Branches that could add no more than a fraction of a shade to the pixel are not followed
+                if (pathWeight * reflectWeight >= PATH_WEIGHT_CUTOFF)
+                    rayColour = reflectWeight * calculateLightforRay(reflectedRay, depth-1, pathWeight * reflectWeight, random);
+                if (pathWeight * refractWeight >= PATH_WEIGHT_CUTOFF)
+                    rayColour = rayColour + refractWeight * calculateLightforRay(refractedRay, depth-1, pathWeight * refractWeight, random);
+            }
+
+        //Return the sum of all light colours added
+        return finalColour + rayColour;
+
+    }
+
+        return finalColour;
+}
+    //Not a valid intersection, so return default color (i.e. black)
+    return colour;
+}
+
+Homogeneous4 Raytracer::tracePath(const Ray &primaryRay, const Scene::CollisionInfo &primaryHit, PixelRandom &random)
+{
+    Cartesian3 radiance(0.0f, 0.0f, 0.0f);
+    //How much of the light leaving the current surface towards the previous one makes it back to the start of the path
+    Cartesian3 throughput(1.0f, 1.0f, 1.0f);
+
+    Ray ray = primaryRay;
+    Scene::CollisionInfo hitInfo = primaryHit;
+    //Lights that a diffuse bounce happens to hit have already been counted by next-event estimation at the surface before,
+    //so only emitters seen straight from the start or in a mirror add their own light
+    bool countEmission = true;
+
+    for (int bounce = 0; bounce < MAX_PATH_LENGTH && hitInfo.t > 0; bounce++)
+    {
+        Triangle transformed;
+        const Triangle &tri = scene->hitTriangle(hitInfo, transformed);
+        const Material *material = tri.shared_material;
+        const Cartesian3 &barycentricCoords = hitInfo.barycentric;
+
+        //We calculate o from our t, since o = origin + t*direction
+        Cartesian3 o = ray.origin + (hitInfo.t*ray.direction);
+        Cartesian3 normal = ((tri.normals[0] * barycentricCoords.x) + (tri.normals[1] * barycentricCoords.y) + (tri.normals[2] * barycentricCoords.z)).Vector().unit();
+        //Light the side of the surface that the ray arrived at
+        bool entering = normal.dot(ray.direction) < 0;
+        if (!entering)
+            normal = -1.0f * normal;
+
+        if (countEmission)
+            radiance = radiance + modulate(throughput, material->emissive);
+
+        //Displace by a small amount to prevent acne
+        float epsilon = 0.001;
+        Cartesian3 origin = o + (epsilon * normal);
+
+        //Next-event estimation: light arriving straight from a random point on each light, for the diffuse part of the material
+        float transparency = material->transparency;
+        float diffuseWeight = (1.0f - transparency) * (1.0f - material->reflectivity);
+        if (diffuseWeight > 0)
+        {
+            Cartesian3 direct(0.0f, 0.0f, 0.0f);
+            unsigned int nLights = lightChoiceCount();
+            for (unsigned int c = 0; c < nLights; c++)
+            {
+                LightChoice choice = chooseLight(origin, c, random);
+                unsigned int i = choice.light;
+
+                float u = random.next();
+                float v = random.next();
+                Cartesian3 lightPoint = renderParameters->lights[i]->GetPositionSample(u, v).Point();
+                Cartesian3 toLight = lightPoint - origin;
+                float distanceSquared = toLight.dot(toLight);
+                Cartesian3 incoming = toLight / sqrt(distanceSquared);
+
+                float cosSurface = normal.dot(incoming);
+                if (cosSurface <= 0)
+                    continue;
+
+                //A point light is an intensity; an area light gives off its colour as radiance from every point,
+                //so its solid angle as seen from o (area * cosine at the light / distance squared) comes in as well
+                float geometry = cosSurface / distanceSquared;
+                if (renderParameters->lights[i]->GetType() == Light::Area)
+                    geometry *= fabs(lightAreaVectors[i].dot(incoming));
+
+                if (geometry > 0 && lightReaches(origin, lightPoint))
+                    direct = direct + (choice.weight * geometry) * lightColours[i].Vector();
+            }
+
+            //Lambertian reflection, diffuse / pi
+            radiance = radiance + (diffuseWeight / float(M_PI)) * modulate(throughput, modulate(material->diffuse, direct));
+        }
+
+        //Scatter: through the surface with probability transparency (which the Fresnel equations then split between
+        //reflection and refraction), otherwise as a mirror with probability reflectivity, and diffusely the rest of the time
+        //Choosing each part in proportion to its weight cancels that weight out of the throughput
+        Ray nextRay;
+        nextRay.origin = origin;
+        float scatter = random.next();
+        if (scatter < transparency)
+        {
+            float ior = refractiveIndex(material);
+            Cartesian3 refracted;
+            float fresnel = fresnelRefract(ray.direction, normal, entering ? 1.0f / ior : ior, refracted);
+            if (random.next() < fresnel)
+                nextRay.direction = (ray.direction - (2*(ray.direction.dot(normal) * normal))).unit();
+            else
+            {
+                nextRay.direction = refracted;
+                nextRay.origin = o - (epsilon * normal);
+            }
+            countEmission = true;
+        }
+        else if (scatter < transparency + (1.0f - transparency) * material->reflectivity)
+        {
+            nextRay.direction = (ray.direction - (2*(ray.direction.dot(normal) * normal))).unit();
+            countEmission = true;
+        }
+        else
+        {
+            //Sampling in proportion to the cosine cancels it, and the pi, out of diffuse * cosine / pdf
+            float u1 = random.next();
+            float u2 = random.next();
+            nextRay.direction = cosineSampleHemisphere(normal, u1, u2).unit();
+            throughput = modulate(throughput, material->diffuse);
+            countEmission = false;
+        }
+
+        //Russian roulette: end the path with probability at least TERMINATION_FACTOR, and more once it carries little light,
+        //scaling up the paths that go on to make up for the ones that stop
+        float survival = std::min(1.0f - TERMINATION_FACTOR, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+        if (random.next() >= survival)
+            break;
+        throughput = throughput / survival;
+
+        ray = nextRay;
+        hitInfo = scene->closestTriangle(ray);
+    }
+
+    return Homogeneous4(radiance);
+}
+
+float Raytracer::lightVisibility(const Cartesian3 &origin, unsigned int light, PixelRandom &random)
+{
+    Light *source = renderParameters->lights[light];
+    unsigned int nSamples = std::min(renderParameters->lightSamples, (unsigned int) MAX_LIGHT_SAMPLES);
+
+    if (source->GetType() != Light::Area || nSamples == 0)
+        return lightReaches(origin, lightPositions[light].Point()) ? 1.0f : 0.0f;
+
+    //Stratified ("n-rooks") sampling: the light is cut into nSamples strips along each edge,
+    //and every sample falls in a strip of each edge that no other sample has used
+    //The strips are handed out in random order, so that however few samples are taken they spread over the whole light
+    unsigned short stripsU[MAX_LIGHT_SAMPLES];
+    unsigned short stripsV[MAX_LIGHT_SAMPLES];
+    for (unsigned int s = 0; s < nSamples; s++)
+    {
+        stripsU[s] = s;
+        stripsV[s] = s;
+    }
+
+    unsigned int lit = 0;
+    for (unsigned int s = 0; s < nSamples; s++)
+    {
+        //Choose this sample's strips from the ones left over (one step of a Fisher-Yates shuffle)
+        std::swap(stripsU[s], stripsU[s + std::min(unsigned((nSamples - s) * random.next()), nSamples - s - 1)]);
+        std::swap(stripsV[s], stripsV[s + std::min(unsigned((nSamples - s) * random.next()), nSamples - s - 1)]);
+
+        float u = (stripsU[s] + random.next()) / nSamples;
+        float v = (stripsV[s] + random.next()) / nSamples;
+        if (lightReaches(origin, source->GetPositionSample(u, v).Point()))
+            lit++;
+
+        //Samples that all agree mean the point is almost certainly outside the penumbra, so the rest can be skipped
+        if (s + 1 == SHADOW_EARLY_OUT && s + 1 < nSamples && (lit == 0 || lit == s + 1))
+            return lit == 0 ? 0.0f : 1.0f;
+    }
+
+    return float(lit) / nSamples;
+}
+
+unsigned int Raytracer::lightChoiceCount() const
+{
+    return samplingLights ? renderParameters->sampledLights : lightPositions.size();
+}
+
+Raytracer::LightChoice Raytracer::chooseLight(const Cartesian3 &point, unsigned int choice, PixelRandom &random) const
+{
+    if (!samplingLights)
+        return {choice, 1.0f};
+
+    float pdf;
+    unsigned int light = lightTree.sample(point, random.next(), pdf);
+    return {light, 1.0f / (pdf * renderParameters->sampledLights)};
+}
+
+bool Raytracer::lightReaches(const Cartesian3 &origin, const Cartesian3 &lightPoint)
+{
+    //The direction is a unit vector, so t along the ray is the distance travelled
+    //Anything that casts a shadow and is hit before the light blocks it
+    Cartesian3 toLight = lightPoint - origin;
+    float lengthToLight = toLight.length();
+    return !scene->occluded(Ray(origin, toLight.unit()), lengthToLight);
+}
+
+Ray Raytracer::calculateRay(float pixelx, float pixely, bool perspective)
+{
+
+    //Size of the whole image, as floats (required for the division - long rounds down to 0)
+    float width = imageWidth();
+    float height = imageHeight();
+
+    //Calculate aspect ratio
+    float aspect = width / height;
+    //x and y are recieved in DCS, so we convert to NDCS
+
+    float xNDS = ((pixelx / width) - 0.5) * 2;
+    float yNDS = ((pixely / height) - 0.5) * 2;
+
+    float x, y, z;
+
+    x = xNDS;
+    y = yNDS;
+    z = -1;
+
+    //We potentially have to factor in the aspect ratio
+    if (aspect > 1)
+        x = xNDS * aspect;
+    else if (aspect < 1)
+        y = yNDS / aspect;
+
+    //Perspective - Camera is at the origin
+    //Otherwise -> Orthographic
+   Ray ray;
+
+    if(perspective)
+    {
+        ray.origin = {0,0,0};
+        ray.direction = {x,y,z};
+    }
+
+    else
+    {
+        ray.origin = {x,y,0};
+        ray.direction = {0, 0, z};
+    }
+
+    //The ray so far is in eye space, but the scene's triangles are in scene space
+    ray.origin = scene->cameraToScene * ray.origin;
+    ray.direction = (scene->cameraToScene * Homogeneous4(ray.direction.x, ray.direction.y, ray.direction.z, 0.0f)).Vector();
+    ray.direction = ray.direction.unit();
+
+    return ray;
+}
+
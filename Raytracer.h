@@ -0,0 +1,165 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include <vector>
+#include <atomic>
+#include <functional>
+#include "RenderParameters.h"
+#include "RGBAImage.h"
+#include "Scene.h"
+#include "Ray.h"
+#include "TileScheduler.h"
+#include "PixelRandom.h"
+#include "LightTree.h"
+#include "ToneMapper.h"
+#include "FloatImage.h"
+
+//The tracing code itself, kept free of Qt so it can run without a window
+//Renders the scene into the frame buffer it was given, using the flags in the render parameters
+class Raytracer
+{
+public:
+    Scene *scene;
+    RenderParameters *renderParameters;
+    RGBAImage *frameBuffer;
+
+    Raytracer(Scene *newScene, RenderParameters *newRenderParameters, RGBAImage *newFrameBuffer);
+
+    //Traces every pixel of the frame buffer (the scene must already be up to date)
+    //The image is split into tiles that are shared out between renderParameters->threadCount threads
+    //Rendering is progressive: each pass adds one jittered sample per pixel to a float accumulation buffer
+    //and redraws the frame buffer from the running averages (see setTone()), until the sample or time budget runs out
+    //With adaptive sampling (renderParameters->adaptiveThreshold > 0) pixels drop out of the passes as their averages settle,
+    //so flat areas stop after a few samples while edges and noisy areas carry on up to the budget
+    void Render();
+
+    //Samples per pixel accumulated so far in the current (or last) render
+    //With adaptive sampling this is the number of passes, which only the pixels that needed the most samples got
+    std::atomic<unsigned int> samplesTaken;
+    //Pixel samples traced so far in the current (or last) render, over the whole image
+    std::atomic<unsigned long long> samplesTraced;
+
+    //Called after every complete pass, with the frame buffer holding the image so far
+    //It may point frameBuffer at another image of the same size, which the next pass then redraws in full
+    std::function<void()> passCompleted;
+    //Called after each tile of each pass is written to the frame buffer, on the render thread that drew it,
+    //so several calls may run at once. Useful for streaming the image out as it renders (see TileWriter)
+    std::function<void(const TileScheduler::Tile &tile)> tileCompleted;
+
+    //Set from another thread to make Render() return early: tiles not yet started are skipped,
+    //so it stops within about one tile's time. Render() leaves it set, it is up to the caller to clear it
+    std::atomic<bool> cancelRequested;
+
+    //Changes how the radiance is turned into displayed colours: exposure in stops, and Reinhard's curve instead of clipping
+    //(usually renderParameters->exposure and toneMapping; they start at 0 and clipping, which is how the renderer always drew)
+    //May be called from another thread during a render, and the following passes use the new settings
+    void setTone(float exposure, bool toneMapping);
+    //Whether the settings have changed since the frame buffer was last drawn
+    bool toneChanged() const;
+    //Draws the whole frame buffer again from the radiance accumulated by the last render, with the current settings,
+    //which takes milliseconds rather than a render. Must not be called while Render() is running
+    //Returns false, leaving the frame buffer alone, if there is no render of its size to draw
+    bool toneMap();
+    //Copies the average radiance of each pixel of tile, as traced so far, into the same pixels of image,
+    //which must be the size of the frame buffer. Pixels without a sample yet are black
+    //May be called from tileCompleted for the tile it was called with, or at any time while Render() is not running
+    void radiance(const TileScheduler::Tile &tile, FloatImage &image) const;
+
+    //Makes the frame buffer one piece of a larger image, for rendering images too big to hold in memory a piece at a time
+    //(see BandedRender): the frame buffer's pixel (0, 0) is pixel (windowX, windowY) of a wholeWidth x wholeHeight image
+    //Rays and random numbers follow the whole image, so the pieces match the whole image rendered at once
+    //(except that adaptive sampling cannot see across the edges of a piece). A wholeWidth of 0, the default, makes the frame buffer the whole image
+    void setWindow(long wholeWidth, long wholeHeight, long windowX, long windowY);
+
+    //Splits the frame into tiles and runs them on a thread pool; holds the timings of the last frame
+    TileScheduler scheduler;
+
+    //Pixel coordinates are in the whole image (see setWindow()), and may be fractional, e.g. for jittered samples
+    Ray calculateRay(float pixelx, float pixely, bool perspective);
+
+    //Whitted-style shading: the light at the closest hit, plus light reflected off and refracted through it, up to depth more bounces
+    //pathWeight is how much the ray adds to the pixel, the product of the reflection and refraction weights on the way to it
+    //random is the pixel sample's own random number stream, used to place shadow rays on area lights
+    Homogeneous4 calculateLightforRay(const Ray &ray, int depth, float pathWeight, PixelRandom &random);
+    //As above, for a ray whose closest hit has already been found
+    Homogeneous4 calculateLightforHit(const Ray &ray, const Scene::CollisionInfo &hitInfo, int depth, float pathWeight, PixelRandom &random);
+
+    //Light reaching the start of ray along it, estimated by following one random path through the scene from hitInfo, its closest hit
+    //Each surface it meets scatters it in a cosine-weighted random direction (the diffuse part of the material),
+    //as a mirror (with probability equal to its reflectivity) or, if transparent, through itself, and is lit directly by the lights on the way (next-event estimation)
+    //Paths end when they leave the scene, or at random by Russian roulette, which keeps the estimate unbiased
+    Homogeneous4 tracePath(const Ray &ray, const Scene::CollisionInfo &hitInfo, PixelRandom &random);
+
+    //Colour of pixel (i, j) of the whole image before gamma correction, given its primary ray and that ray's closest hit
+    Homogeneous4 calculatePixelColour(const Ray &ray, const Scene::CollisionInfo &hitInfo, int i, int j, PixelRandom &random);
+
+    //Fraction of a light that can be seen from origin, from 0 (in full shadow) to 1 (fully lit)
+    //Area lights are sampled at renderParameters->lightSamples stratified points across them, for soft shadows;
+    //point lights (and area lights, when lightSamples is 0) only have their centre, so they give 0 or 1
+    float lightVisibility(const Cartesian3 &origin, unsigned int light, PixelRandom &random);
+
+    //A light to shade a point with, and the factor to scale what it adds by
+    struct LightChoice
+    {
+        unsigned int light;
+        float weight;
+    };
+
+    //Number of lights each point is shaded with: every light, unless the scene has more than renderParameters->sampledLights
+    unsigned int lightChoiceCount() const;
+    //The choice-th of the lights to shade point with: simply that light, with weight 1, when every light is used;
+    //otherwise one drawn from lightTree and weighted by 1 / (its probability * lightChoiceCount()),
+    //so that on average the chosen lights add up to the same as every light would
+    LightChoice chooseLight(const Cartesian3 &point, unsigned int choice, PixelRandom &random) const;
+
+private:
+    //Traces one sample for each pixel of a tile and updates the tile in the frame buffer
+    void renderTile(const TileScheduler::Tile &tile, unsigned int sample, const ToneMapper &toneMapper);
+    //Writes the running average of each pixel of a tile to the frame buffer
+    void toneMapTile(const TileScheduler::Tile &tile, const ToneMapper &toneMapper);
+
+    //The image the frame buffer is part of, and where in it, as set by setWindow()
+    long wholeWidth, wholeHeight;
+    long windowX, windowY;
+    //Size of the whole image, which is just the frame buffer unless setWindow() says otherwise
+    float imageWidth() const;
+    float imageHeight() const;
+
+    //Tone settings, which setTone() may change at any time, and the ones the frame buffer was last drawn with
+    std::atomic<float> exposure;
+    std::atomic<bool> toneMapping;
+    float drawnExposure;
+    bool drawnToneMapping;
+    //A tone mapper for the current settings, which are then taken to be the ones the frame buffer is drawn with
+    ToneMapper currentToneMapper();
+
+    //Whether the straight line from origin to a point on a light is clear of anything that casts a shadow
+    bool lightReaches(const Cartesian3 &origin, const Cartesian3 &lightPoint);
+
+    //Running sum of the (linear, pre-gamma) samples for each pixel, row by row
+    std::vector<Cartesian3> accumulation;
+    //Number of samples in each pixel's sum, which differ from pixel to pixel once adaptive sampling has stopped some of them
+    std::vector<unsigned int> sampleCounts;
+    //Whether each pixel gets a sample in the next pass
+    std::vector<unsigned char> activePixels;
+    //Running sums of the brightness of each pixel's samples, and of its square, for the variance of the pixel's mean
+    //The brightness is judged with the exposure and tone curve of the pass that took the sample (see ToneMapper::brightness()),
+    //so noise is measured as it will be seen; changing them once the render has finished does not sample any further
+    std::vector<float> brightnessSums;
+    std::vector<float> brightnessSquares;
+
+    //Stops sampling the pixels whose averages have settled, returning how many are still active
+    unsigned int updateActivePixels();
+
+    //Light positions in scene space and their colours, filled in at the start of Render()
+    std::vector<Homogeneous4> lightPositions;
+    std::vector<Homogeneous4> lightColours;
+    //Normal of each area light scaled by its area (zero for point lights), for the path tracer
+    std::vector<Cartesian3> lightAreaVectors;
+    //BVH over the lights, also built by Render(), for choosing among them in scenes with many lights
+    LightTree lightTree;
+    //Whether this frame shades with lights drawn from lightTree rather than every light
+    bool samplingLights;
+};
+
+#endif // RAYTRACER_H
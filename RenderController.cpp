@@ -70,6 +70,10 @@ RenderController::RenderController
     QObject::connect(   renderWindow->yTranslateSlider,             SIGNAL(valueChanged(int)),
                         this,                                       SLOT(yTranslateChanged(int)));
 
+    // signal for exposure slider
+    QObject::connect(   renderWindow->exposureSlider,               SIGNAL(valueChanged(int)),
+                        this,                                       SLOT(exposureChanged(int)));
+
 
     // signal for check box
     QObject::connect(   renderWindow->phongshadingBox,              SIGNAL(stateChanged(int)),
@@ -82,6 +86,12 @@ RenderController::RenderController
                         this,                                       SLOT(reflectionBoxChanged(int)));
     QObject::connect( renderWindow->orthographicBox,                SIGNAL(stateChanged(int)),
                        this,                                        SLOT(orthographicBoxChanged(int)));
+    QObject::connect(   renderWindow->bvhBox,                       SIGNAL(stateChanged(int)),
+                        this,                                       SLOT(bvhBoxChanged(int)));
+    QObject::connect(   renderWindow->pathTracingBox,               SIGNAL(stateChanged(int)),
+                        this,                                       SLOT(pathTracingBoxChanged(int)));
+    QObject::connect(   renderWindow->toneMappingBox,               SIGNAL(stateChanged(int)),
+                        this,                                       SLOT(toneMappingBoxChanged(int)));
     //Signal for push button
     QObject::connect(   renderWindow->raytraceButton,               SIGNAL(released()),
                         this,                                       SLOT(raytraceCalled()));
@@ -151,6 +161,22 @@ void RenderController::zTranslateChanged(int value)
     renderWindow->ResetInterface();
     } // RenderController::xTranslateChanged()
 
+// slot for responding to the exposure slider
+void RenderController::exposureChanged(int value)
+    { // RenderController::exposureChanged()
+    // reset the exposure (slider ticks are 1/100 of a stop each)
+    renderParameters->exposure = value / 100.0f;
+
+    // clamp it
+    if (renderParameters->exposure < EXPOSURE_MIN)
+        renderParameters->exposure = EXPOSURE_MIN;
+    else if (renderParameters->exposure > EXPOSURE_MAX)
+        renderParameters->exposure = EXPOSURE_MAX;
+
+    // only the display of the ray traced image changes, so it is redrawn rather than rendered again
+    renderWindow->raytraceRenderWidget->ToneChanged();
+    } // RenderController::exposureChanged()
+
 
 void RenderController::phongShadingCheckChanged(int state)
     {
@@ -197,6 +223,33 @@ void RenderController::orthographicBoxChanged(int state)
     renderWindow->ResetInterface();
     }
 
+void RenderController::bvhBoxChanged(int state)
+    {
+    // reset the model's flag
+    renderParameters->bvhEnabled = (state == Qt::Checked);
+
+    // reset the interface
+    renderWindow->ResetInterface();
+    }
+
+void RenderController::pathTracingBoxChanged(int state)
+    {
+    // reset the model's flag
+    renderParameters->pathTracing = (state == Qt::Checked);
+
+    // reset the interface
+    renderWindow->ResetInterface();
+    }
+
+void RenderController::toneMappingBoxChanged(int state)
+    {
+    // reset the model's flag
+    renderParameters->toneMapping = (state == Qt::Checked);
+
+    // redraw the ray traced image, without rendering it again
+    renderWindow->raytraceRenderWidget->ToneChanged();
+    }
+
 void RenderController::raytraceCalled()
     {
     renderWindow->handle_raytrace();
@@ -64,6 +64,7 @@ class RenderController : public QObject
     void xTranslateChanged(int value);
     void yTranslateChanged(int value);
     void zTranslateChanged(int value);
+    void exposureChanged(int value);
 
     // slots for responding to check boxes
     void phongShadingCheckChanged(int state);
@@ -71,6 +72,9 @@ class RenderController : public QObject
     void shadowBoxCheckChanged(int state);
     void reflectionBoxChanged(int state);
     void orthographicBoxChanged(int state);
+    void bvhBoxChanged(int state);
+    void pathTracingBoxChanged(int state);
+    void toneMappingBoxChanged(int state);
 
     //slots respoding to the push button
     void raytraceCalled();
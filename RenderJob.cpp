@@ -0,0 +1,93 @@
+#include "RenderJob.h"
+
+RenderJob::RenderJob(std::vector<ThreeDModel> *objects)
+    : scene(objects, &parameters),
+      raytracer(&scene, &parameters, nullptr)
+{
+    busy = false;
+
+    //Each finished pass goes to the display, and the next one is drawn into a spare image
+    raytracer.passCompleted = [this]() { raytracer.frameBuffer = images.publish(); };
+}
+
+RenderJob::~RenderJob()
+{
+    cancel();
+}
+
+bool RenderJob::start(const RenderParameters &newParameters, long width, long height)
+{
+    cancel();
+
+    //Nothing else touches the snapshot or the images while no render is running
+    //(the display reads the images too, but from this same thread)
+    parameters = newParameters;
+    if ((width != images.width() || height != images.height()) && !images.Resize(width, height))
+        return false;
+    raytracer.frameBuffer = images.back();
+    raytracer.setTone(parameters.exposure, parameters.toneMapping);
+
+    raytracer.cancelRequested = false;
+    busy = true;
+    thread = std::thread(&RenderJob::run, this);
+    return true;
+}
+
+void RenderJob::cancel()
+{
+    raytracer.cancelRequested = true;
+    if (thread.joinable())
+        thread.join();
+    busy = false;
+}
+
+void RenderJob::retone(float exposure, bool toneMapping)
+{
+    std::lock_guard<std::mutex> lock(toneMutex);
+    raytracer.setTone(exposure, toneMapping);
+    if (!busy)
+        redraw();
+}
+
+bool RenderJob::running() const
+{
+    return busy;
+}
+
+const RGBAImage &RenderJob::latestImage()
+{
+    return images.front();
+}
+
+void RenderJob::setCompletionCallback(const CompletionCallback &callback)
+{
+    completionCallback = callback;
+}
+
+void RenderJob::run()
+{
+    //The scene is brought up to date on the render thread too, so the interface never waits for it
+    //(only the first render builds the triangles and BVH, later ones just pick up the new camera)
+    scene.updateScene();
+    if (!raytracer.cancelRequested)
+        raytracer.Render();
+
+    bool completed = !raytracer.cancelRequested;
+    {
+        //The last pass may have been drawn with settings retone() has changed since
+        std::lock_guard<std::mutex> lock(toneMutex);
+        busy = false;
+        if (completed && raytracer.toneChanged())
+            redraw();
+    }
+
+    if (completionCallback)
+        completionCallback(completed);
+}
+
+void RenderJob::redraw()
+{
+    raytracer.frameBuffer = images.back();
+    if (raytracer.toneMap())
+        raytracer.frameBuffer = images.publish();
+}
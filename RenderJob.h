@@ -0,0 +1,76 @@
+#ifndef RENDERJOB_H
+#define RENDERJOB_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include "ThreeDModel.h"
+#include "RenderParameters.h"
+#include "TripleBuffer.h"
+#include "Scene.h"
+#include "Raytracer.h"
+
+//A render running on its own thread, which can be cancelled or restarted at any time
+//Each start() cancels the render under way first, so there is only ever one render using the cores.
+//The job works from its own copy of the render parameters and its own scene, so the interface is free
+//to change the originals while it runs. It also owns the images it renders into, and hands each finished
+//pass to the display through a triple buffer, so the display never sees a half drawn pass and never
+//holds up the render threads
+class RenderJob
+{
+public:
+    //Called on the render thread when a render ends; completed is false if it was cancelled
+    typedef std::function<void(bool completed)> CompletionCallback;
+
+    explicit RenderJob(std::vector<ThreeDModel> *objects);
+    //Cancels the render under way and waits for it
+    ~RenderJob();
+
+    RenderJob(const RenderJob &) = delete;
+    RenderJob &operator=(const RenderJob &) = delete;
+
+    //Abandons any render under way and starts a new width x height one from a snapshot of newParameters
+    //The display keeps showing the last published image until the new render finishes its first pass,
+    //unless the size changes, in which case it goes blank first
+    //Returns false, starting nothing, if the images cannot be made width x height
+    bool start(const RenderParameters &newParameters, long width, long height);
+
+    //Changes the exposure and tone curve of the image without rendering it again (see Raytracer::setTone())
+    //A render under way picks them up from its next pass; otherwise the last image is redrawn and published straight away
+    void retone(float exposure, bool toneMapping);
+
+    //Stops the render under way (if any) and returns once its thread has finished,
+    //which takes at most about the time of one tile
+    void cancel();
+
+    //True from start() until the render finishes or is cancelled
+    bool running() const;
+
+    void setCompletionCallback(const CompletionCallback &callback);
+
+    //For the display: the most recent complete pass. Must be called from the thread that calls start()
+    const RGBAImage &latestImage();
+
+    //Snapshot of the parameters the current (or last) render was started with
+    RenderParameters parameters;
+    Scene scene;
+    Raytracer raytracer;
+
+private:
+    //Render thread writes the back image, the display reads the front one
+    TripleBuffer images;
+
+    std::thread thread;
+    std::atomic<bool> busy;
+    //Held while the render thread finishes, so that retone() either reaches the render or redraws after it, never both at once
+    std::mutex toneMutex;
+    CompletionCallback completionCallback;
+
+    void run();
+    //Tone maps the last render into the back image and publishes it
+    void redraw();
+};
+
+#endif // RENDERJOB_H
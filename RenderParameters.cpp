@@ -1,22 +1,71 @@
 #include "RenderParameters.h"
 
-void RenderParameters::findLights(std::vector<ThreeDModel> objects)
+RenderParameters::RenderParameters(const RenderParameters &other)
 {
-    for(ThreeDModel obj: objects)
+    *this = other;
+}
+
+RenderParameters &RenderParameters::operator =(const RenderParameters &other)
+{
+    if (this == &other)
+        return *this;
+
+    xTranslate = other.xTranslate;
+    yTranslate = other.yTranslate;
+    zTranslate = other.zTranslate;
+    rotationMatrix = other.rotationMatrix;
+
+    interpolationRendering = other.interpolationRendering;
+    phongEnabled = other.phongEnabled;
+    shadowsEnabled = other.shadowsEnabled;
+    reflectionEnabled = other.reflectionEnabled;
+    pathTracing = other.pathTracing;
+    centreObject = other.centreObject;
+    orthoProjection = other.orthoProjection;
+    bvhEnabled = other.bvhEnabled;
+    packetTracing = other.packetTracing;
+    tileSize = other.tileSize;
+    threadCount = other.threadCount;
+    sampleBudget = other.sampleBudget;
+    timeBudget = other.timeBudget;
+    adaptiveThreshold = other.adaptiveThreshold;
+    lightSamples = other.lightSamples;
+    sampledLights = other.sampledLights;
+    exposure = other.exposure;
+    toneMapping = other.toneMapping;
+
+    //Deep copy the lights, since each RenderParameters deletes its own
+    for (unsigned int i = 0; i < lights.size(); i++)
+        delete lights[i];
+    lights.clear();
+    for (unsigned int i = 0; i < other.lights.size(); i++)
+        lights.push_back(new Light(*other.lights[i]));
+
+    return *this;
+}
+
+void RenderParameters::findLights(const std::vector<ThreeDModel> &objects)
+{
+    for(const ThreeDModel &obj: objects)
     {
+        //Models with no material (no usemtl, or an unknown name) are drawn with the default one, which is not a light,
+        //and models with no faces have nowhere to put one
+        if (obj.material == nullptr || obj.cornerVertices.empty())
+            continue;
+
         //find objects that have a "light" material
         if(obj.material->isLight())
         {
             //if the object has exactly 2 triangles, its a rectangular area light.
-            if(obj.faceVertices.size()== 2)
+            if(obj.faceCount()== 2)
             {
                 for (unsigned int i = 0; i < 3; i++)
                 {
-                    unsigned int vid = obj.faceVertices[0][i];
+                    unsigned int vid = obj.cornerVertices[obj.faceOffsets[0] + i];
                     bool found = false;
                     for (unsigned int j = 0; j < 3; j++)
                     {
-                        if (vid == obj.faceVertices[1][j])
+                        if (vid == obj.cornerVertices[obj.faceOffsets[1] + j])
                         {
                             found = true;
                             break;
@@ -26,17 +75,17 @@ void RenderParameters::findLights(std::vector<ThreeDModel> objects)
 
                     if(!found)
                         {
-                            unsigned int id1 = obj.faceVertices[0][i];
-                            unsigned int id2 = obj.faceVertices[0][(i+1) % 3];
-                            unsigned int id3 = obj.faceVertices[0][(i+2) % 3];
-                            Cartesian3 v1 = obj.vertices[id1];
-                            Cartesian3 v2 = obj.vertices[id2];
-                            Cartesian3 v3 = obj.vertices[id3];
+                            unsigned int id1 = obj.cornerVertices[obj.faceOffsets[0] + i];
+                            unsigned int id2 = obj.cornerVertices[obj.faceOffsets[0] + (i+1) % 3];
+                            unsigned int id3 = obj.cornerVertices[obj.faceOffsets[0] + (i+2) % 3];
+                            Cartesian3 v1 = obj.attributes->vertices[id1];
+                            Cartesian3 v2 = obj.attributes->vertices[id2];
+                            Cartesian3 v3 = obj.attributes->vertices[id3];
                             Cartesian3 vecA = v2 - v1;
                             Cartesian3 vecB = v3 - v1;
                             Homogeneous4 color = obj.material->emissive;
                             Homogeneous4 pos = v1 + (vecA/2) + (vecB/2);
-                            Homogeneous4 normal = obj.normals[obj.faceNormals[0][0]];
+                            Homogeneous4 normal = obj.attributes->normals[obj.cornerNormals[obj.faceOffsets[0]]];
                             Light *l = new Light(Light::Area, color, pos, normal, vecA, vecB);
                             l->enabled = true;
                             lights.push_back(l);
@@ -47,13 +96,15 @@ void RenderParameters::findLights(std::vector<ThreeDModel> objects)
 
             else
             {
+                //The vertex pool is shared by every model in the file, so only this model's own corners are averaged
                 Cartesian3 center = Cartesian3(0,0,0);
-                for (unsigned int i = 0; i < obj.vertices.size(); i++)
+                const std::vector<Cartesian3> &vertices = obj.attributes->vertices;
+                for (unsigned int i = 0; i < obj.cornerVertices.size(); i++)
                 {
-                    center = center + obj.vertices[i];
+                    center = center + vertices[obj.cornerVertices[i]];
                 }
 
-                center = center / obj.vertices.size();
+                center = center / obj.cornerVertices.size();
                 Light *l = new Light(Light::Point, obj.material->emissive, center, Homogeneous4(), Homogeneous4(), Homogeneous4());
                 l->enabled = true;
                 lights.push_back(l);
@@ -23,6 +23,15 @@
 #include "Light.h"
 #include <vector>
 
+// default number of samples per pixel in a progressive render
+#define N_LOOPS 100
+// default threshold for adaptive sampling, a little over one step of an 8 bit channel
+#define ADAPTIVE_THRESHOLD 0.005f
+// default number of shadow rays per area light
+#define N_LIGHT_SAMPLES 16
+// default number of lights each point is shaded with, in scenes with more lights than that
+#define N_SAMPLED_LIGHTS 4
+
 //here not to break the includes
 class ThreeDModel;
 #include "ThreeDModel.h"
@@ -50,11 +59,45 @@ class RenderParameters
     bool phongEnabled;
     bool shadowsEnabled;
     bool reflectionEnabled;
+    // Monte Carlo path tracing (global illumination) instead of the shading modes above
+    bool pathTracing;
 
     bool centreObject;
 
     bool orthoProjection;
 
+    // use the BVH for ray queries (otherwise every triangle is tested)
+    bool bvhEnabled;
+
+    // trace neighbouring primary rays through the BVH together as a packet
+    bool packetTracing;
+
+    // the image is rendered in square tiles of this many pixels
+    int tileSize;
+    // number of render threads, 0 for one per hardware thread
+    unsigned int threadCount;
+
+    // a progressive render stops after this many samples per pixel
+    unsigned int sampleBudget;
+    // or after this many seconds, if greater than 0 (the pass under way is always finished)
+    float timeBudget;
+    // adaptive sampling: pixels stop getting samples once the standard error of their brightness (0 to 1, as displayed)
+    // falls below this, and their neighbours' has too; 0 samples every pixel up to the budget
+    float adaptiveThreshold;
+
+    // shadow rays per area light for each shading point, spread across the light for soft shadows
+    // 0 treats area lights as points at their centres, as before
+    unsigned int lightSamples;
+
+    // scenes with more lights than this shade each point with only this many, chosen at random
+    // with nearer and brighter lights more likely (see LightTree); 0 always uses every light
+    unsigned int sampledLights;
+
+    // exposure of the displayed image in stops: each +1 doubles the brightness of the rendered radiance
+    float exposure;
+    // map the radiance into the displayable range with Reinhard's curve rather than clipping it
+    // (neither this nor the exposure needs the scene traced again, see Raytracer::setTone())
+    bool toneMapping;
 
     // constructor
     RenderParameters()
@@ -66,15 +109,31 @@ class RenderParameters
         phongEnabled(false),
         shadowsEnabled(false),
         reflectionEnabled(false),
+        pathTracing(false),
 
         centreObject(false),
-        orthoProjection(false)
+        orthoProjection(false),
+        bvhEnabled(true),
+        packetTracing(true),
+        tileSize(16),
+        threadCount(0),
+        sampleBudget(N_LOOPS),
+        timeBudget(0.0f),
+        adaptiveThreshold(ADAPTIVE_THRESHOLD),
+        lightSamples(N_LIGHT_SAMPLES),
+        sampledLights(N_SAMPLED_LIGHTS),
+        exposure(0.0f),
+        toneMapping(false)
         { // constructor
 
         // because we are paranoid, we will initialise the matrices to the identity
         rotationMatrix.SetIdentity();
         } // constructor
 
+    // copies own their lights, so a render can keep a snapshot while the interface changes the original
+    RenderParameters(const RenderParameters &other);
+    RenderParameters &operator =(const RenderParameters &other);
+
     // descructor
     ~RenderParameters()
     {
@@ -86,7 +145,7 @@ class RenderParameters
 
     // accessor for scaledXTranslate
 
-    void findLights(std::vector<ThreeDModel> objects);
+    void findLights(const std::vector<ThreeDModel> &objects);
 
     }; // class RenderParameters
 
@@ -107,6 +166,9 @@ class RenderParameters
 #define SPECULAR_EXPONENT_MIN 0.01f
 #define SPECULAR_EXPONENT_MAX 100.0f
 
+#define EXPOSURE_MIN -4.0f
+#define EXPOSURE_MAX 4.0f
+
 // this is to scale to/from integer values
 #define PARAMETER_SCALING 100
 
@@ -64,12 +64,16 @@ RenderWindow::RenderWindow
     shadowBox            = new QCheckBox                 ("Shadow",            this);
     reflectionBox        = new QCheckBox                 ("Reflection",            this);
     orthographicBox      = new QCheckBox                 ("Orthographic",           this);
+    bvhBox               = new QCheckBox                 ("BVH",                    this);
+    pathTracingBox       = new QCheckBox                 ("Path tracing",           this);
+    toneMappingBox       = new QCheckBox                 ("Tone mapping",           this);
 
     // spatial sliders
     xTranslateSlider            = new QSlider                   (Qt::Horizontal,        this);
     secondXTranslateSlider      = new QSlider                   (Qt::Horizontal,        this);
     yTranslateSlider            = new QSlider                   (Qt::Vertical,          this);
     zTranslateSlider            = new QSlider                   (Qt::Vertical,          this);
+    exposureSlider              = new QSlider                   (Qt::Horizontal,        this);
 
     //push buttons
     raytraceButton      = new QPushButton               ("Raytrace", this);
@@ -78,6 +82,7 @@ RenderWindow::RenderWindow
     modelRotatorLabel           = new QLabel                    ("Model",               this);
     yTranslateLabel             = new QLabel                    ("Y",                   this);
     zoomLabel                   = new QLabel                    ("Zm",                  this);
+    exposureLabel               = new QLabel                    ("Exposure",            this);
 
     // add all of the widgets to the grid               Row         Column      Row Span    Column Span
 
@@ -97,6 +102,11 @@ RenderWindow::RenderWindow
     windowLayout->addWidget(shadowBox,                  4,         3,          1,          1           );
     windowLayout->addWidget(reflectionBox,              5,         3,          1,          1           );
     windowLayout->addWidget(orthographicBox,            6,          3,          1,          1          );
+    windowLayout->addWidget(bvhBox,                     7,          3,          1,          1          );
+    windowLayout->addWidget(pathTracingBox,             8,          3,          1,          1          );
+    windowLayout->addWidget(toneMappingBox,             9,          3,          1,          1          );
+    windowLayout->addWidget(exposureLabel,              10,         3,          1,          1          );
+    windowLayout->addWidget(exposureSlider,             11,         3,          1,          1          );
 
     // Translate Slider Row
     windowLayout->addWidget(xTranslateSlider,           nStacked,   1,          1,          1           );
@@ -123,6 +133,9 @@ void RenderWindow::ResetInterface()
     shadowBox    ->setChecked        (renderParameters   ->  shadowsEnabled);
     phongshadingBox    ->setChecked        (renderParameters   ->  phongEnabled);
     reflectionBox    ->setChecked        (renderParameters   ->  reflectionEnabled);
+    bvhBox    ->setChecked        (renderParameters   ->  bvhEnabled);
+    pathTracingBox    ->setChecked        (renderParameters   ->  pathTracing);
+    toneMappingBox    ->setChecked        (renderParameters   ->  toneMapping);
 
     // set sliders
     // x & y translate are scaled to notional unit sphere in render widgets
@@ -144,6 +157,11 @@ void RenderWindow::ResetInterface()
     zTranslateSlider  ->setMaximum        (int(TRANSLATE_MAX                               * PARAMETER_SCALING));
     zTranslateSlider  ->setValue          (int(renderParameters -> zTranslate              * PARAMETER_SCALING));
 
+    // exposure is in stops, either side of 0
+    exposureSlider          ->setMinimum        (int(EXPOSURE_MIN                                * PARAMETER_SCALING));
+    exposureSlider          ->setMaximum        (int(EXPOSURE_MAX                                * PARAMETER_SCALING));
+    exposureSlider          ->setValue          (int(renderParameters -> exposure                * PARAMETER_SCALING));
+
     // main lighting parameters are simple 0.0-1.0
 
     // now flag them all for update
@@ -154,11 +172,18 @@ void RenderWindow::ResetInterface()
     secondXTranslateSlider  ->update();
     yTranslateSlider        ->update();
     zTranslateSlider        ->update();
+    exposureSlider          ->update();
     interpolationBox        ->update();
     phongshadingBox         ->update();
     interpolationBox        ->update();
     shadowBox               ->update();
     reflectionBox           ->update();
+    bvhBox                  ->update();
+    pathTracingBox          ->update();
+    toneMappingBox          ->update();
+
+    // and bring the ray traced image up to date, if there is one
+    raytraceRenderWidget    ->ParametersChanged();
 
     } // RenderWindow::ResetInterface()
 
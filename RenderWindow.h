@@ -67,6 +67,9 @@ class RenderWindow : public QWidget
     QCheckBox                   *centreObjectBox;
     QCheckBox                   *scaleObjectBox;
     QCheckBox*                  orthographicBox;
+    QCheckBox                   *bvhBox;
+    QCheckBox                   *pathTracingBox;
+    QCheckBox                   *toneMappingBox;
 
 
     // sliders for spatial manipulation
@@ -75,6 +78,8 @@ class RenderWindow : public QWidget
     QSlider                     *secondXTranslateSlider;
     QSlider                     *yTranslateSlider;
     QSlider                     *zTranslateSlider;
+    // slider for the exposure of the ray traced image
+    QSlider                     *exposureSlider;
 
 
 
@@ -82,6 +87,7 @@ class RenderWindow : public QWidget
     QLabel                      *modelRotatorLabel;
     QLabel                      *yTranslateLabel;
     QLabel                      *zoomLabel;
+    QLabel                      *exposureLabel;
 
 
     //button for raytracing
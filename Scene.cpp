@@ -1,4 +1,6 @@
 #include "Scene.h"
+#include <limits>
+#include <algorithm>
 
 Scene::Scene(std::vector<ThreeDModel> *texobjs, RenderParameters *renderp)
 {
@@ -11,64 +13,181 @@ Scene::Scene(std::vector<ThreeDModel> *texobjs, RenderParameters *renderp)
 
     float shininess = 1.0f;
     default_mat = new Material(ambient, diffuse, specular, emissive, shininess);
+
+    rayCount = 0;
+    geometryBuilt = false;
+    instancesAdded = false;
+    instancesMoved = false;
+}
+
+void Scene::resetRayCount()
+{
+    rayCount = 0;
 }
 
 void Scene::updateScene()
 {
-    triangles.clear();
-    for (int i = 0; i < int(objects ->size()); i++)
+    if (!geometryBuilt)
+    {
+        buildGeometry();
+        geometryBuilt = true;
+    }
+    updateTopLevel();
+
+    modelView = getModelView();
+    cameraToScene = modelView.inverse();
+    eye = cameraToScene * Cartesian3(0.0f, 0.0f, 0.0f);
+}
+
+void Scene::geometryChanged()
+{
+    geometryBuilt = false;
+}
+
+void Scene::updateTopLevel()
+{
+    if (!instancesAdded && !instancesMoved)
+        return;
+
+    std::vector<Cartesian3> boundsMin(instances.size()), boundsMax(instances.size());
+    for (unsigned int i = 0; i < instances.size(); i++)
+    {
+        boundsMin[i] = instances[i].boundsMin;
+        boundsMax[i] = instances[i].boundsMax;
+    }
+
+    //Moving instances keeps the shape of the tree, new ones need a new tree
+    //Either way the meshes' own BVHs are untouched
+    if (instancesAdded)
+        topLevel.build(boundsMin, boundsMax);
+    else
+        topLevel.refit(boundsMin, boundsMax);
+
+    instancesAdded = false;
+    instancesMoved = false;
+}
+
+void Scene::buildGeometry()
+{
+    meshes.clear();
+    meshes.resize(objects->size());
+    instances.clear();
+
+    Matrix4 identity;
+    identity.SetIdentity();
+
+    for (unsigned int model = 0; model < objects->size(); model++)
     {
         typedef unsigned int uint;
-        ThreeDModel obj = objects->at(uint(i));
-        for (uint face = 0; face < obj.faceVertices.size(); face++)
+        const ThreeDModel &obj = (*objects)[model];
+        Mesh &mesh = meshes[model];
+        const std::vector<Cartesian3> &vertices = obj.attributes->vertices;
+        const std::vector<Cartesian3> &normals = obj.attributes->normals;
+        const std::vector<Cartesian3> &textureCoords = obj.attributes->textureCoords;
+        Material *material = obj.material == nullptr ? default_mat : obj.material;
+        bool blocksLight = !material->isLight();
+
+        //Every face becomes a fan of (corners - 2) triangles, so the arrays can be sized up front
+        //(counted face by face, as a face with fewer than 3 corners, e.g. from a damaged cache, gives none)
+        size_t triangleCount = 0;
+        for (uint face = 0; face < obj.faceCount(); face++)
+            triangleCount += std::max(obj.faceOffsets[face + 1] - obj.faceOffsets[face], 2u) - 2;
+        mesh.triangles.reserve(triangleCount);
+        mesh.compactTriangles.reserve(triangleCount);
+        mesh.castsShadow.reserve(triangleCount);
+
+        //The corners of all the faces are stored one after the other, so this walks straight through them
+        for (uint face = 0; face < obj.faceCount(); face++)
         {
-            for (uint triangle = 0; triangle < obj.faceVertices[face].size()-2; triangle++)
+            uint firstCorner = obj.faceOffsets[face];
+            uint lastCorner = obj.faceOffsets[face + 1];
+            for (uint corner = firstCorner + 1; corner + 1 < lastCorner; corner++)
             {
                 Triangle t;
+                const uint triangleCorners[3] = {firstCorner, corner, corner + 1};
                 for (uint vertex = 0; vertex < 3; vertex++)
                 {
-                    uint faceVertex = 0;
-                    if (vertex != 0)
-                        faceVertex = triangle + vertex;
+                    uint c = triangleCorners[vertex];
+                    const Cartesian3 &position = vertices[obj.cornerVertices[c]];
+                    t.verts[vertex] = Homogeneous4(position.x, position.y, position.z);
 
-                    Homogeneous4 v = Homogeneous4(obj.vertices[obj.faceVertices     [face][faceVertex]].x,
-                                                  obj.vertices[obj.faceVertices     [face][faceVertex]].y,
-                                                  obj.vertices[obj.faceVertices     [face][faceVertex]].z);
+                    const Cartesian3 &normal = normals[obj.cornerNormals[c]];
+                    t.normals[vertex] = Homogeneous4(normal.x, normal.y, normal.z, 0.0f);
 
-                    v = getModelView() * v;
+                    const Cartesian3 &tex = textureCoords[obj.cornerTexCoords[c]];
+                    t.uvs[vertex] = Cartesian3(tex.x, tex.y, 0.0f);
+                    t.colors[vertex] = Cartesian3(0.7f, 0.7f, 0.7f);
+                }
+                t.shared_material = material;
 
-                    t.verts[vertex] = v;
-                    Homogeneous4 n = Homogeneous4(obj.normals[obj.faceNormals       [face][faceVertex]].x,
-                                                  obj.normals[obj.faceNormals       [face][faceVertex]].y,
-                                                  obj.normals[obj.faceNormals       [face][faceVertex]].z,
-                                                  0.0f);
+                mesh.triangles.push_back(t);
+                mesh.compactTriangles.push_back(CompactTriangle(t.verts[0].Point(), t.verts[1].Point(), t.verts[2].Point()));
+                mesh.castsShadow.push_back(blocksLight);
+            }
+        }
 
-                    n = getModelView() * n;
-                    t.normals[vertex] = n;
+        mesh.anyCastsShadow = blocksLight && !mesh.triangles.empty();
+        mesh.bvh.build(mesh.compactTriangles);
 
-                    Cartesian3 tex = Cartesian3(obj.textureCoords[obj.faceTexCoords[face][faceVertex]].x,
-                                                obj.textureCoords[obj.faceTexCoords[face][faceVertex]].y,
-                                                0.0f);
-                    t.uvs[vertex] = tex;
-                    t.colors[vertex] = Cartesian3(0.7f, 0.7f, 0.7f);
-                }
+        addInstance(model, identity);
+    }
+}
 
-                if(obj.material == nullptr)
-                {
-                    t.shared_material = default_mat;
-                }
+unsigned int Scene::addInstance(unsigned int model, const Matrix4 &transform)
+{
+    //Value initialised, as it is copied into the list before setInstanceTransform() fills in the rest
+    Instance instance{};
+    instance.mesh = model;
+    instances.push_back(instance);
+    setInstanceTransform(instances.size() - 1, transform);
+    instancesAdded = true;
+    return instances.size() - 1;
+}
 
-                else
-                {
-                    t.shared_material = obj.material;
-                }
+void Scene::setInstanceTransform(unsigned int instance, const Matrix4 &transform)
+{
+    Instance &target = instances[instance];
+    instancesMoved = true;
+    Matrix4 identity;
+    identity.SetIdentity();
 
-                triangles.push_back(t);
-            }
-        }
+    target.transform = transform;
+    target.inverse = transform.inverse();
+    target.normalTransform = target.inverse.transpose();
+    //Compared exactly, since only a true identity lets the transforms be skipped without changing the image
+    target.identity = true;
+    for (int row = 0; row < 4; row++)
+        for (int col = 0; col < 4; col++)
+            if (transform[row][col] != identity[row][col])
+                target.identity = false;
+
+    //Transform the corners of the mesh's box, and take the box around them
+    //An empty mesh gets an inside-out box, which leaves it out of the top level BVH
+    const BVH &bvh = meshes[target.mesh].bvh;
+    float infinity = std::numeric_limits<float>::infinity();
+    target.boundsMin = Cartesian3(infinity, infinity, infinity);
+    target.boundsMax = Cartesian3(-infinity, -infinity, -infinity);
+    if (bvh.empty())
+        return;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        Cartesian3 point((corner & 1) ? bvh.nodes[0].boundsMax.x : bvh.nodes[0].boundsMin.x,
+                         (corner & 2) ? bvh.nodes[0].boundsMax.y : bvh.nodes[0].boundsMin.y,
+                         (corner & 4) ? bvh.nodes[0].boundsMax.z : bvh.nodes[0].boundsMin.z);
+        point = transform * point;
+        target.boundsMin = Cartesian3(std::min(target.boundsMin.x, point.x), std::min(target.boundsMin.y, point.y), std::min(target.boundsMin.z, point.z));
+        target.boundsMax = Cartesian3(std::max(target.boundsMax.x, point.x), std::max(target.boundsMax.y, point.y), std::max(target.boundsMax.z, point.z));
     }
 }
 
+size_t Scene::triangleCount() const
+{
+    size_t count = 0;
+    for (const Instance &instance : instances)
+        count += meshes[instance.mesh].triangles.size();
+    return count;
+}
+
 Matrix4 Scene::getModelView()
 {
     //Initialise result matrix
@@ -87,42 +206,184 @@ Matrix4 Scene::getModelView()
     return result;
 }
 
-Scene::CollisionInfo Scene::closestTriangle(Ray r)
+//Takes a scene space ray into an instance's object space
+//The direction is not normalised again, so t means the same distance along the ray in both spaces
+static Ray objectSpaceRay(const Scene::Instance &instance, const Ray &r)
+{
+    if (instance.identity)
+        return r;
+    Homogeneous4 direction(r.direction.x, r.direction.y, r.direction.z, 0.0f);
+    return Ray(instance.inverse * r.origin, (instance.inverse * direction).Vector());
+}
+
+Scene::CollisionInfo Scene::closestTriangle(const Ray &r) const
 {
     Scene::CollisionInfo ci;
 
     //Set a placeholder value so there isn't an out of bounds error
     ci.t = -1;
+    ci.instance = 0;
+    ci.triangle = 0;
 
-    //We loop through every triangle in the scene
-    for (Triangle currentTriangle : triangles)
+    rayCount.fetch_add(1, std::memory_order_relaxed);
+
+    float tBest = std::numeric_limits<float>::max();
+
+    //Finds the closest hit in one instance, and keeps it if it beats the best so far
+    auto visit = [&](unsigned int i)
     {
-        //Get the value of t by intersection test
-        float t = currentTriangle.intersect(r);
+        const Mesh &mesh = meshes[instances[i].mesh];
+        Ray objectRay = objectSpaceRay(instances[i], r);
 
-        //Test if the current value of t is less than the currently stored value of t (means that the triangle is closer to the ray)
-        //First of all, test that the placeholder value of ci.t still holds
-        if (ci.t < 0)
+        unsigned int index = 0;
+        float t, u, v;
+        bool hit = false;
+
+        if (rp->bvhEnabled)
         {
-            //Replace the placeholder value with current t, if it's positive
-            if(t > 0)
-            {
-                ci.tri = currentTriangle;
-                ci.t = t;
-            }
+            hit = mesh.bvh.closestHit(objectRay, t, u, v, index, tBest);
         }
 
-        //When ci.t has a positive value, check if current t is less than saved t
         else
         {
-            if(t > 0 && t < ci.t)
+            //We loop through every triangle in the mesh, keeping the closest hit
+            //Only a strictly closer hit replaces the current one, so ties go to the lowest index
+            for (unsigned int j = 0; j < mesh.compactTriangles.size(); j++)
             {
-                //std::cout<< "Updated t -> " << t << std::endl;
-                ci.tri = currentTriangle;
-                ci.t = t;
+                float tTest, uTest, vTest;
+                if (mesh.compactTriangles[j].intersect(objectRay, tTest, uTest, vTest) && (!hit || tTest < t))
+                {
+                    t = tTest;
+                    u = uTest;
+                    v = vTest;
+                    index = j;
+                    hit = true;
+                }
             }
         }
-    }
+
+        //Ties between instances go to the lowest numbered one, whatever order they are visited in
+        if (hit && (ci.t < 0 || t < tBest || (t == tBest && i < ci.instance)))
+        {
+            tBest = t;
+            ci.instance = i;
+            ci.triangle = index;
+            ci.t = t;
+            ci.barycentric = Cartesian3(1.0f - u - v, u, v);
+        }
+        return false;
+    };
+
+    //Use the BVHs unless the linear scan has been asked for (e.g. to check the BVHs against it)
+    if (rp->bvhEnabled)
+        topLevel.traverse(r, tBest, visit);
+    else
+        for (unsigned int i = 0; i < instances.size(); i++)
+            visit(i);
 
     return ci;
 }
+
+bool Scene::occluded(const Ray &r, float maxDistance) const
+{
+    rayCount.fetch_add(1, std::memory_order_relaxed);
+
+    //Returns true if something in one instance blocks the ray, which ends the search
+    auto visit = [&](unsigned int i)
+    {
+        const Mesh &mesh = meshes[instances[i].mesh];
+        if (!mesh.anyCastsShadow)
+            return false;
+
+        Ray objectRay = objectSpaceRay(instances[i], r);
+
+        if (rp->bvhEnabled)
+            return mesh.bvh.anyHit(objectRay, maxDistance, mesh.castsShadow);
+
+        for (unsigned int j = 0; j < mesh.compactTriangles.size(); j++)
+        {
+            float t, u, v;
+            if (mesh.castsShadow[j] && mesh.compactTriangles[j].intersect(objectRay, t, u, v) && t < maxDistance)
+                return true;
+        }
+        return false;
+    };
+
+    bool blocked = false;
+    if (rp->bvhEnabled)
+    {
+        float tMax = maxDistance;
+        topLevel.traverse(r, tMax, [&](unsigned int i) { blocked = visit(i); return blocked; });
+    }
+    else
+        for (unsigned int i = 0; i < instances.size() && !blocked; i++)
+            blocked = visit(i);
+
+    return blocked;
+}
+
+void Scene::closestTriangles(const Ray *rays, CollisionInfo *hits) const
+{
+    //The packet only pays off with the BVH, the linear scan just takes the rays one at a time
+    if (!rp->bvhEnabled)
+    {
+        for (int k = 0; k < BVH_PACKET_SIZE; k++)
+            hits[k] = closestTriangle(rays[k]);
+        return;
+    }
+
+    rayCount.fetch_add(BVH_PACKET_SIZE, std::memory_order_relaxed);
+
+    float tBest[BVH_PACKET_SIZE];
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+    {
+        tBest[k] = std::numeric_limits<float>::max();
+        hits[k].t = -1;
+        hits[k].instance = 0;
+        hits[k].triangle = 0;
+    }
+
+    topLevel.traversePacket(rays, tBest, [&](unsigned int i)
+    {
+        Ray objectRays[BVH_PACKET_SIZE];
+        for (int k = 0; k < BVH_PACKET_SIZE; k++)
+            objectRays[k] = objectSpaceRay(instances[i], rays[k]);
+
+        bool found[BVH_PACKET_SIZE];
+        float t[BVH_PACKET_SIZE], u[BVH_PACKET_SIZE], v[BVH_PACKET_SIZE];
+        unsigned int index[BVH_PACKET_SIZE];
+        meshes[instances[i].mesh].bvh.closestHitPacket(objectRays, found, t, u, v, index, tBest);
+
+        for (int k = 0; k < BVH_PACKET_SIZE; k++)
+        {
+            //Ties between instances go to the lowest numbered one, as in closestTriangle()
+            if (found[k] && (hits[k].t < 0 || t[k] < tBest[k] || (t[k] == tBest[k] && i < hits[k].instance)))
+            {
+                tBest[k] = t[k];
+                hits[k].instance = i;
+                hits[k].triangle = index[k];
+                hits[k].t = t[k];
+                hits[k].barycentric = Cartesian3(1.0f - u[k] - v[k], u[k], v[k]);
+            }
+        }
+        return false;
+    });
+}
+
+const Triangle &Scene::hitTriangle(const CollisionInfo &hit, Triangle &spare) const
+{
+    const Instance &instance = instances[hit.instance];
+    const Triangle &triangle = meshes[instance.mesh].triangles[hit.triangle];
+    if (instance.identity)
+        return triangle;
+
+    spare = triangle;
+    for (int vertex = 0; vertex < 3; vertex++)
+    {
+        spare.verts[vertex] = instance.transform * triangle.verts[vertex];
+        //Normals stay unit length, as they are in the model
+        Cartesian3 normal = (instance.normalTransform * triangle.normals[vertex]).Vector().unit();
+        spare.normals[vertex] = Homogeneous4(normal.x, normal.y, normal.z, 0.0f);
+    }
+    return spare;
+}
@@ -2,31 +2,123 @@
 #define SCENE_H
 
 #include <vector>
+#include <atomic>
 #include "ThreeDModel.h"
 #include "RenderParameters.h"
 #include "Triangle.h"
 #include "Material.h"
 #include "Ray.h"
+#include "BVH.h"
+#include "TopLevelBVH.h"
 
 class Scene
 {
 public:
     std::vector<ThreeDModel>* objects;
     RenderParameters* rp;
-    std::vector<Triangle> triangles;
+
+    //The triangles of one model in its own (object) space, with their acceleration structure
+    //Built once and shared by every instance of the model, however many there are
+    struct Mesh
+    {
+        std::vector<Triangle> triangles;
+        //Intersection data for each entry in triangles, precomputed along with them
+        std::vector<CompactTriangle> compactTriangles;
+        //Whether each entry in triangles blocks light, i.e. is not itself emissive
+        std::vector<bool> castsShadow;
+        //Whether any entry of castsShadow is set, so shadow rays can skip the mesh altogether if not
+        bool anyCastsShadow;
+        BVH bvh;
+    };
+
+    //One copy of a mesh, placed in the scene by a transform
+    struct Instance
+    {
+        unsigned int mesh;
+        //Object space to scene space, and back again (rays are taken into object space to be traced)
+        Matrix4 transform;
+        Matrix4 inverse;
+        //Inverse transpose of transform, which takes normals to scene space
+        Matrix4 normalTransform;
+        //Set when transform is the identity, so rays and triangles can be used as they are
+        bool identity;
+        //Box around the transformed mesh in scene space, so rays that miss it need not be transformed
+        Cartesian3 boundsMin;
+        Cartesian3 boundsMax;
+    };
+
+    //One mesh per model, in the same order as objects
+    std::vector<Mesh> meshes;
+    //Everything that is drawn: to begin with one instance per model, with the identity transform
+    std::vector<Instance> instances;
+    //BVH over the boxes of the instances, above the meshes' own BVHs
+    TopLevelBVH topLevel;
+
     Scene(std::vector<ThreeDModel> *texobjs, RenderParameters *renderp);
+    //Gets the scene ready to render with the current parameters
+    //The meshes are built by the first call (or the first after geometryChanged()),
+    //later calls only update the camera transform below
     void updateScene();
+    //Call after changing the models, so that the next updateScene() builds the meshes again
+    //(the instances go back to one per model)
+    void geometryChanged();
     Material *default_mat;
 
+    //Places another copy of a model's mesh in the scene, returning the index of the new instance
+    //Only valid once updateScene() has built the meshes
+    //Changes to the instances are picked up by the next updateScene(), which only has to update the top level BVH:
+    //it is refitted when instances have just moved, and rebuilt when there are new ones
+    unsigned int addInstance(unsigned int model, const Matrix4 &transform);
+    //Moves an existing instance
+    void setInstanceTransform(unsigned int instance, const Matrix4 &transform);
+
+    //Number of triangles drawn, counting each instance of a mesh
+    size_t triangleCount() const;
+
     Matrix4 getModelView();
 
+    //Camera transform set by updateScene(): modelView takes scene space to eye space,
+    //and cameraToScene takes rays from eye space back into scene space
+    Matrix4 modelView;
+    Matrix4 cameraToScene;
+    //The eye (the origin of eye space) in scene space
+    Cartesian3 eye;
+
+    //Hit record: the triangle is referred to by its index in its instance's mesh rather than copied
     struct CollisionInfo
     {
-        Triangle tri;
+        unsigned int instance;
+        unsigned int triangle;
         float t;
+        //Weights of the triangle's three vertices at the hit point
+        Cartesian3 barycentric;
     };
 
-    CollisionInfo closestTriangle (Ray r);
+    //Rays are in scene space; t is measured along them as given, whatever the instance's transform
+    CollisionInfo closestTriangle (const Ray &r) const;
+    //Shadow query: true if anything that casts a shadow lies along r closer than maxDistance
+    //Stops at the first such triangle rather than looking for the closest one
+    bool occluded(const Ray &r, float maxDistance) const;
+    //closestTriangle() for BVH_PACKET_SIZE coherent rays at once, filling in one hit record per ray
+    void closestTriangles(const Ray *rays, CollisionInfo *hits) const;
+
+    //The triangle that was hit, in scene space, for shading
+    //A reference to the mesh's own triangle when the instance is not transformed, otherwise a transformed copy in spare
+    const Triangle &hitTriangle(const CollisionInfo &hit, Triangle &spare) const;
+
+    //Number of ray queries made since the last reset, for benchmarking
+    mutable std::atomic<unsigned long long> rayCount;
+    void resetRayCount();
+
+private:
+    //Whether meshes and instances match the models
+    bool geometryBuilt;
+    void buildGeometry();
+
+    //What has happened to the instances since the top level BVH was last brought up to date
+    bool instancesAdded;
+    bool instancesMoved;
+    void updateTopLevel();
 };
 
 #endif // SCENE_H
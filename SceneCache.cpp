@@ -0,0 +1,476 @@
+#include "SceneCache.h"
+#include "MappedFile.h"
+#include "ObjReader.h"
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+    const char MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+    const char TRAILER[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'D', '\0'};
+    //Written as a number and read back as one, so a cache from a machine of the other byte order is not used
+    const uint32_t ENDIAN_MARKER = 0x01020304u;
+
+    //Identifies the contents of one of the files a scene was read from
+    struct Fingerprint
+    {
+        std::string path;
+        uint64_t size;
+        int64_t modified;
+        uint64_t hash;
+
+        //The same file may be reached by another path, so only the contents are compared
+        bool sameContents(const Fingerprint &other) const
+        {
+            return size == other.size && modified == other.modified && hash == other.hash;
+        }
+    };
+
+    //64 bit hash of a block of memory, a word at a time. Not cryptographic, but any edit to a
+    //source file changes it, and it runs at close to memory speed so it can be checked on every load
+    //Four independent lanes keep the multiplies from waiting on each other
+    uint64_t hashBytes(const char *data, size_t size)
+    {
+        const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+        uint64_t lanes[4] = {size, size + 1, size + 2, size + 3};
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+            for (int lane = 0; lane < 4; lane++)
+            {
+                uint64_t word;
+                std::memcpy(&word, data + i + 8 * lane, 8);
+                uint64_t mixed = (lanes[lane] ^ word) * multiplier;
+                lanes[lane] = mixed ^ (mixed >> 29);
+            }
+
+        //Whatever is left over is folded in a byte at a time
+        uint64_t hash = 0;
+        for (int lane = 0; lane < 4; lane++)
+            hash = (hash ^ lanes[lane]) * multiplier;
+        for (; i < size; i++)
+            hash = (hash ^ uint64_t(static_cast<unsigned char>(data[i]))) * multiplier;
+        return hash ^ (hash >> 32);
+    }
+
+    bool fingerprint(const std::string &path, Fingerprint &result)
+    {
+        std::error_code error;
+        std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+        if (error)
+            return false;
+
+        MappedFile file;
+        if (!file.open(path))
+            return false;
+
+        result.path = path;
+        result.size = file.size();
+        result.modified = int64_t(modified.time_since_epoch().count());
+        result.hash = hashBytes(file.data(), file.size());
+        return true;
+    }
+
+    //Sequential writer for the cache file
+    class Writer
+    {
+    public:
+        explicit Writer(std::ofstream &stream) : out(stream) {}
+
+        template <class T> void put(T value)
+        {
+            out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void putBytes(const void *data, size_t size)
+        {
+            out.write(static_cast<const char *>(data), std::streamsize(size));
+        }
+
+        void putString(const std::string &value)
+        {
+            put<uint64_t>(value.size());
+            putBytes(value.data(), value.size());
+        }
+
+        void putIndices(const std::vector<unsigned int> &values)
+        {
+            put<uint64_t>(values.size());
+            putBytes(values.data(), values.size() * sizeof(unsigned int));
+        }
+
+        void putVector(const Cartesian3 &value)
+        {
+            float xyz[3] = {value.x, value.y, value.z};
+            putBytes(xyz, sizeof(xyz));
+        }
+
+        void putVectors(const std::vector<Cartesian3> &values)
+        {
+            put<uint64_t>(values.size());
+            for (const Cartesian3 &value : values)
+                putVector(value);
+        }
+
+    private:
+        std::ofstream &out;
+    };
+
+    //Reads the cache file back from memory, failing (rather than reading past the end) if it is cut short
+    class Reader
+    {
+    public:
+        Reader(const char *data, size_t size) : p(data), end(data + size), good(true) {}
+
+        bool ok() const
+        {
+            return good;
+        }
+
+        bool atEnd() const
+        {
+            return p == end;
+        }
+
+        template <class T> T get()
+        {
+            T value = T();
+            getBytes(&value, sizeof(T));
+            return value;
+        }
+
+        void getBytes(void *data, size_t size)
+        {
+            if (!good || size_t(end - p) < size)
+            {
+                good = false;
+                return;
+            }
+            std::memcpy(data, p, size);
+            p += size;
+        }
+
+        //A count of elements of the given size, checked against what is left of the file
+        size_t getCount(size_t elementSize)
+        {
+            uint64_t count = get<uint64_t>();
+            if (!good || count > uint64_t(end - p) / elementSize)
+            {
+                good = false;
+                return 0;
+            }
+            return size_t(count);
+        }
+
+        std::string getString()
+        {
+            size_t length = getCount(1);
+            std::string value(length, '\0');
+            getBytes(&value[0], length);
+            return value;
+        }
+
+        void getIndices(std::vector<unsigned int> &values)
+        {
+            values.resize(getCount(sizeof(unsigned int)));
+            getBytes(values.data(), values.size() * sizeof(unsigned int));
+        }
+
+        Cartesian3 getVector()
+        {
+            float xyz[3] = {0.0f, 0.0f, 0.0f};
+            getBytes(xyz, sizeof(xyz));
+            return Cartesian3(xyz[0], xyz[1], xyz[2]);
+        }
+
+        void getVectors(std::vector<Cartesian3> &values)
+        {
+            values.resize(getCount(3 * sizeof(float)));
+            for (Cartesian3 &value : values)
+                value = getVector();
+        }
+
+    private:
+        const char *p;
+        const char *end;
+        bool good;
+    };
+
+    //True if every index is below limit
+    bool indicesBelow(const std::vector<unsigned int> &indices, size_t limit)
+    {
+        return std::all_of(indices.begin(), indices.end(), [limit](unsigned int index) { return index < limit; });
+    }
+}
+
+SceneCache::SceneCache(unsigned int threadCount)
+{
+    this->threadCount = threadCount;
+    cacheUsed = false;
+}
+
+std::string SceneCache::cacheFilename(const std::string &geometryFilename)
+{
+    return geometryFilename + ".rtcache";
+}
+
+bool SceneCache::usedCache() const
+{
+    return cacheUsed;
+}
+
+std::vector<ThreeDModel> SceneCache::load(const std::string &geometryFilename, const std::string &materialFilename)
+{
+    cacheUsed = false;
+    std::vector<ThreeDModel> models;
+    std::string cache = cacheFilename(geometryFilename);
+    if (read(cache, geometryFilename, materialFilename, models))
+    {
+        cacheUsed = true;
+        return models;
+    }
+
+    std::ifstream materialFile(materialFilename.c_str());
+    if (!materialFile.good())
+        return models;
+    ObjReader objReader(threadCount);
+    models = objReader.read(geometryFilename, materialFile);
+
+    //Not being able to write the cache (a read-only directory, say) only costs time on the next run
+    if (!models.empty())
+        write(cache, geometryFilename, materialFilename, models);
+    return models;
+}
+
+bool SceneCache::write(const std::string &cacheFilename, const std::string &geometryFilename, const std::string &materialFilename,
+                       const std::vector<ThreeDModel> &models)
+{
+    if (models.empty())
+        return false;
+
+    //The cache holds one set of vertex data, which all the models from one file share
+    const std::shared_ptr<MeshAttributes> &attributes = models[0].attributes;
+    std::vector<Material *> materials;
+    for (const ThreeDModel &model : models)
+    {
+        if (model.attributes != attributes)
+            return false;
+        if (model.material != nullptr && std::find(materials.begin(), materials.end(), model.material) == materials.end())
+            materials.push_back(model.material);
+    }
+
+    std::vector<Fingerprint> sources(2);
+    if (!fingerprint(geometryFilename, sources[0]) || !fingerprint(materialFilename, sources[1]))
+        return false;
+    for (Material *material : materials)
+        if (!material->textureFilename.empty())
+        {
+            Fingerprint texture;
+            if (!fingerprint(material->textureFilename, texture))
+                return false;
+            sources.push_back(texture);
+        }
+
+    std::string temporaryFilename = cacheFilename + ".tmp";
+    {
+        std::ofstream out(temporaryFilename.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out.good())
+            return false;
+        Writer writer(out);
+
+        writer.putBytes(MAGIC, sizeof(MAGIC));
+        writer.put<uint32_t>(VERSION);
+        writer.put<uint32_t>(ENDIAN_MARKER);
+
+        writer.put<uint64_t>(sources.size());
+        for (const Fingerprint &source : sources)
+        {
+            writer.putString(source.path);
+            writer.put<uint64_t>(source.size);
+            writer.put<int64_t>(source.modified);
+            writer.put<uint64_t>(source.hash);
+        }
+
+        writer.put<uint64_t>(materials.size());
+        for (const Material *material : materials)
+        {
+            writer.putString(material->name);
+            writer.put<uint8_t>(material->setFromFile);
+            writer.putVector(material->ambient);
+            writer.putVector(material->diffuse);
+            writer.putVector(material->specular);
+            writer.putVector(material->emissive);
+            writer.put<float>(material->shininess);
+            writer.put<float>(material->reflectivity);
+            writer.put<float>(material->indexOfRefraction);
+            writer.put<float>(material->transparency);
+            writer.putString(material->textureFilename);
+
+            //Textures are stored decoded, four bytes per texel
+            const RGBAImage *texture = material->texture;
+            writer.put<uint8_t>(texture != nullptr);
+            if (texture != nullptr)
+            {
+                writer.put<int64_t>(texture->width);
+                writer.put<int64_t>(texture->height);
+                for (long texel = 0; texel < texture->width * texture->height; texel++)
+                {
+                    const RGBAValue &value = texture->block[texel];
+                    unsigned char rgba[4] = {value.red, value.green, value.blue, value.alpha};
+                    writer.putBytes(rgba, 4);
+                }
+            }
+        }
+
+        writer.putVectors(attributes->vertices);
+        writer.putVectors(attributes->normals);
+        writer.putVectors(attributes->textureCoords);
+
+        writer.put<uint64_t>(models.size());
+        for (const ThreeDModel &model : models)
+        {
+            int32_t material = -1;
+            if (model.material != nullptr)
+                material = int32_t(std::find(materials.begin(), materials.end(), model.material) - materials.begin());
+            writer.put<int32_t>(material);
+            writer.putIndices(model.faceOffsets);
+            writer.putIndices(model.cornerVertices);
+            writer.putIndices(model.cornerNormals);
+            writer.putIndices(model.cornerTexCoords);
+        }
+
+        writer.putBytes(TRAILER, sizeof(TRAILER));
+        out.close();
+        if (!out)
+        {
+            std::remove(temporaryFilename.c_str());
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryFilename, cacheFilename, error);
+    if (error)
+    {
+        std::remove(temporaryFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool SceneCache::read(const std::string &cacheFilename, const std::string &geometryFilename, const std::string &materialFilename,
+                      std::vector<ThreeDModel> &models)
+{
+    MappedFile file;
+    if (!file.open(cacheFilename))
+        return false;
+    Reader reader(file.data(), file.size());
+
+    char magic[sizeof(MAGIC)];
+    reader.getBytes(magic, sizeof(magic));
+    if (!reader.ok() || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    if (reader.get<uint32_t>() != VERSION || reader.get<uint32_t>() != ENDIAN_MARKER)
+        return false;
+
+    //The first two sources are always the geometry and material files, the rest are textures
+    size_t sourceCount = reader.getCount(4 * sizeof(uint64_t));
+    if (sourceCount < 2)
+        return false;
+    for (size_t i = 0; i < sourceCount; i++)
+    {
+        Fingerprint stored;
+        stored.path = reader.getString();
+        stored.size = reader.get<uint64_t>();
+        stored.modified = reader.get<int64_t>();
+        stored.hash = reader.get<uint64_t>();
+        if (!reader.ok())
+            return false;
+
+        const std::string &path = i == 0 ? geometryFilename : i == 1 ? materialFilename : stored.path;
+        Fingerprint current;
+        if (!fingerprint(path, current) || !current.sameContents(stored))
+            return false;
+    }
+
+    size_t materialCount = reader.getCount(1);
+    std::vector<std::unique_ptr<Material>> materials;
+    for (size_t i = 0; i < materialCount && reader.ok(); i++)
+    {
+        std::unique_ptr<Material> material(new Material());
+        material->name = reader.getString();
+        material->setFromFile = reader.get<uint8_t>() != 0;
+        material->ambient = reader.getVector();
+        material->diffuse = reader.getVector();
+        material->specular = reader.getVector();
+        material->emissive = reader.getVector();
+        material->shininess = reader.get<float>();
+        material->reflectivity = reader.get<float>();
+        material->indexOfRefraction = reader.get<float>();
+        material->transparency = reader.get<float>();
+        material->textureFilename = reader.getString();
+
+        if (reader.get<uint8_t>() != 0)
+        {
+            int64_t width = reader.get<int64_t>();
+            int64_t height = reader.get<int64_t>();
+            material->texture = new RGBAImage();
+            if (!reader.ok() || width < 0 || height < 0 || !material->texture->Resize(long(width), long(height)))
+                return false;
+            for (long texel = 0; texel < width * height; texel++)
+            {
+                unsigned char rgba[4] = {0, 0, 0, 0};
+                reader.getBytes(rgba, 4);
+                material->texture->block[texel] = RGBAValue(rgba[0], rgba[1], rgba[2], rgba[3]);
+            }
+        }
+        materials.push_back(std::move(material));
+    }
+
+    std::shared_ptr<MeshAttributes> attributes = std::make_shared<MeshAttributes>();
+    reader.getVectors(attributes->vertices);
+    reader.getVectors(attributes->normals);
+    reader.getVectors(attributes->textureCoords);
+
+    size_t modelCount = reader.getCount(sizeof(int32_t));
+    std::vector<ThreeDModel> loaded(modelCount);
+    for (ThreeDModel &model : loaded)
+    {
+        int32_t material = reader.get<int32_t>();
+        if (material < -1 || material >= int32_t(materials.size()))
+            return false;
+        model.material = material < 0 ? nullptr : materials[size_t(material)].get();
+        model.attributes = attributes;
+        reader.getIndices(model.faceOffsets);
+        reader.getIndices(model.cornerVertices);
+        reader.getIndices(model.cornerNormals);
+        reader.getIndices(model.cornerTexCoords);
+        if (!reader.ok())
+            return false;
+
+        //A damaged cache must not hand the renderer indices that run off the end of the arrays
+        size_t corners = model.cornerVertices.size();
+        if (model.faceOffsets.empty() || model.faceOffsets.front() != 0 || model.faceOffsets.back() != corners
+            || !std::is_sorted(model.faceOffsets.begin(), model.faceOffsets.end())
+            || model.cornerNormals.size() != corners || model.cornerTexCoords.size() != corners
+            || !indicesBelow(model.cornerVertices, attributes->vertices.size())
+            || !indicesBelow(model.cornerNormals, attributes->normals.size())
+            || !indicesBelow(model.cornerTexCoords, attributes->textureCoords.size()))
+            return false;
+    }
+
+    char trailer[sizeof(TRAILER)];
+    reader.getBytes(trailer, sizeof(trailer));
+    if (!reader.ok() || std::memcmp(trailer, TRAILER, sizeof(TRAILER)) != 0 || !reader.atEnd())
+        return false;
+
+    //Materials live as long as the program, as they do when read from the .mtl file
+    for (std::unique_ptr<Material> &material : materials)
+        material.release();
+    models.swap(loaded);
+    return true;
+}
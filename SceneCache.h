@@ -0,0 +1,45 @@
+#ifndef SCENECACHE_H
+#define SCENECACHE_H
+
+#include <string>
+#include <vector>
+#include "ThreeDModel.h"
+
+//Binary copy of a loaded scene (models, vertex data, materials and decoded textures), so that
+//later runs can skip parsing the .obj, .mtl and texture files altogether
+//
+//The cache records the size, modification time and a hash of every file the scene was read from,
+//and is only used while all of them still match. It is written to a temporary file and renamed
+//into place, so a crash while writing never leaves a broken cache behind
+class SceneCache
+{
+public:
+    //Bumped whenever the layout of the file changes, so that old caches are rebuilt rather than misread
+    static const unsigned int VERSION = 1;
+
+    //threadCount is for the ObjReader used when the cache is missing or out of date (0 means one per hardware thread)
+    explicit SceneCache(unsigned int threadCount = 0);
+
+    //The cache file used for a geometry file: the same name with .rtcache on the end
+    static std::string cacheFilename(const std::string &geometryFilename);
+
+    //Loads the scene from its cache if that is up to date, and otherwise reads the source files
+    //and writes a new cache for next time. Returns no models if the sources cannot be read
+    std::vector<ThreeDModel> load(const std::string &geometryFilename, const std::string &materialFilename);
+
+    //The two halves of load(). read() returns false (and leaves models alone) if the cache is
+    //missing, out of date, from another version or damaged
+    bool read(const std::string &cacheFilename, const std::string &geometryFilename, const std::string &materialFilename,
+              std::vector<ThreeDModel> &models);
+    bool write(const std::string &cacheFilename, const std::string &geometryFilename, const std::string &materialFilename,
+               const std::vector<ThreeDModel> &models);
+
+    //Whether the last load() came from the cache
+    bool usedCache() const;
+
+private:
+    unsigned int threadCount;
+    bool cacheUsed;
+};
+
+#endif // SCENECACHE_H
@@ -0,0 +1,129 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    function = nullptr;
+    generation = 0;
+    running = 0;
+    stopping = false;
+
+    for (unsigned int i = 0; i < threadCount; i++)
+        queues.emplace_back(new Queue);
+
+    //Worker 0 is whichever thread calls run(), so only the others need a thread of their own
+    for (unsigned int i = 1; i < threadCount; i++)
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (unsigned int i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+unsigned int ThreadPool::size() const
+{
+    return queues.size();
+}
+
+void ThreadPool::run(unsigned int taskCount, const TaskFunction &taskFunction)
+{
+    //Deal the tasks out in contiguous runs, so neighbouring tasks (e.g. tiles) stay on one worker
+    unsigned int nWorkers = size();
+    for (unsigned int worker = 0; worker < nWorkers; worker++)
+    {
+        Queue &queue = *queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.clear();
+        unsigned int first = (unsigned long long)taskCount * worker / nWorkers;
+        unsigned int last = (unsigned long long)taskCount * (worker + 1) / nWorkers;
+        for (unsigned int task = first; task < last; task++)
+            queue.tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        function = &taskFunction;
+        running = nWorkers - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    //Wait for the background workers to run out of tasks too
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return running == 0; });
+    function = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned int worker)
+{
+    unsigned long long seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        work(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        finished.notify_one();
+    }
+}
+
+void ThreadPool::work(unsigned int worker)
+{
+    unsigned int task;
+    while (nextTask(worker, task))
+        (*function)(task, worker);
+}
+
+bool ThreadPool::nextTask(unsigned int worker, unsigned int &task)
+{
+    //Our own share first, from the front
+    {
+        Queue &queue = *queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+
+    //Then steal from the back of the others, starting with our neighbour so thieves spread out
+    unsigned int nWorkers = size();
+    for (unsigned int i = 1; i < nWorkers; i++)
+    {
+        Queue &queue = *queues[(worker + i) % nWorkers];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,60 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+//Fixed set of worker threads that run numbered tasks in parallel, with work stealing
+//Each worker starts on its own contiguous share of the tasks and, once that runs out,
+//takes tasks from the far end of the other workers' shares
+class ThreadPool
+{
+public:
+    //The function run for each task, given the task number and the worker running it (0 to size() - 1)
+    typedef std::function<void(unsigned int task, unsigned int worker)> TaskFunction;
+
+    //threadCount 0 means one thread per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    //Number of workers, including the thread that calls run()
+    unsigned int size() const;
+
+    //Runs function for tasks 0 to taskCount - 1 and returns once all of them are done
+    //The calling thread works as worker 0, so a pool of size 1 starts no threads at all
+    void run(unsigned int taskCount, const TaskFunction &function);
+
+private:
+    //One worker's share of the tasks: the owner takes from the front, thieves from the back
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<unsigned int> tasks;
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    //Hands each run() to the background workers
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const TaskFunction *function;
+    unsigned long long generation;
+    unsigned int running;
+    bool stopping;
+
+    void workerLoop(unsigned int worker);
+    void work(unsigned int worker);
+    bool nextTask(unsigned int worker, unsigned int &task);
+};
+
+#endif // THREADPOOL_H
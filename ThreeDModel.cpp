@@ -41,12 +41,35 @@
 // constructor will initialise to safe values
 ThreeDModel::ThreeDModel()
     { // TexturedObject()
-    // force arrays to size 0
-    vertices.resize(0);
-    normals.resize(0);
-    textureCoords.resize(0);
+    // start with empty vertex data of our own, and no faces
+    attributes = std::make_shared<MeshAttributes>();
+    faceOffsets.assign(1, 0);
+    // no material or texture until one is assigned
+    material = nullptr;
+    textureID = 0;
     } // TexturedObject()
 
+// number of faces
+unsigned int ThreeDModel::faceCount() const
+    { // faceCount()
+    return static_cast<unsigned int>(faceOffsets.size() - 1);
+    } // faceCount()
+
+// number of corners on a face
+unsigned int ThreeDModel::faceSize(unsigned int face) const
+    { // faceSize()
+    return faceOffsets[face + 1] - faceOffsets[face];
+    } // faceSize()
+
+// add a face with the given corners
+void ThreeDModel::addFace(const unsigned int *vertexIDs, const unsigned int *normalIDs, const unsigned int *texCoordIDs, unsigned int nCorners)
+    { // addFace()
+    cornerVertices.insert(cornerVertices.end(), vertexIDs, vertexIDs + nCorners);
+    cornerNormals.insert(cornerNormals.end(), normalIDs, normalIDs + nCorners);
+    cornerTexCoords.insert(cornerTexCoords.end(), texCoordIDs, texCoordIDs + nCorners);
+    faceOffsets.push_back(static_cast<unsigned int>(cornerVertices.size()));
+    } // addFace()
+
 // read routine returns true on success, failure otherwise
 std::vector<ThreeDModel> ThreeDModel::ReadObjectStreamMaterial(std::istream &geometryStream, std::istream &materialStream)
     { // ReadObjectStreamMaterial()
@@ -63,9 +86,10 @@ std::vector<ThreeDModel> ThreeDModel::ReadObjectStreamMaterial(std::istream &geo
 
 
     //Vertex data is shared between everyone
-    std::vector<Cartesian3> vertices;
-    std::vector<Cartesian3> normals;
-    std::vector<Cartesian3> textureCoords;
+    std::shared_ptr<MeshAttributes> shared = t.attributes;
+    std::vector<Cartesian3> &vertices = shared->vertices;
+    std::vector<Cartesian3> &normals = shared->normals;
+    std::vector<Cartesian3> &textureCoords = shared->textureCoords;
 
     // the rest of this is a loop reading lines & adding them in appropriate places
     while (true)
@@ -181,9 +205,7 @@ std::vector<ThreeDModel> ThreeDModel::ReadObjectStreamMaterial(std::istream &geo
                 // as long as the face has at least three vertices, add to the master list
                 if (faceVertexSet.size() > 2)
                     { // at least 3
-                    t.faceVertices.push_back(faceVertexSet);
-                    t.faceNormals.push_back(faceNormalSet);
-                    t.faceTexCoords.push_back(faceTexCoordSet);
+                    t.addFace(faceVertexSet.data(), faceNormalSet.data(), faceTexCoordSet.data(), static_cast<unsigned int>(faceVertexSet.size()));
                     } // at least 3
 
                 break;
@@ -203,11 +225,9 @@ std::vector<ThreeDModel> ThreeDModel::ReadObjectStreamMaterial(std::istream &geo
                             t.material = m;
                             break;
                         }else{
-                            t.vertices.assign(vertices.begin(),vertices.end());
-                            t.normals.assign(normals.begin(),normals.end());
-                            t.textureCoords.assign(textureCoords.begin(),textureCoords.end());
                             r.push_back(t);
                             t = ThreeDModel();
+                            t.attributes = shared;
                             m = ms.at(i);
                             t.material = m;
                         }
@@ -219,9 +239,6 @@ std::vector<ThreeDModel> ThreeDModel::ReadObjectStreamMaterial(std::istream &geo
         } // not eof
 
     t.material = m;
-    t.vertices.assign(vertices.begin(),vertices.end());
-    t.normals.assign(normals.begin(),normals.end());
-    t.textureCoords.assign(textureCoords.begin(),textureCoords.end());
     r.push_back(t);
     return r;
     } // ReadObjectStreamMaterial()
@@ -270,21 +287,21 @@ std::vector<ThreeDModel> ThreeDModel::ReadObjectStream(std::istream &geometryStr
                         { // vertex read
                         Cartesian3 vertex;
                         geometryStream >> vertex;
-                        t.vertices.push_back(vertex);
+                        t.attributes->vertices.push_back(vertex);
                         break;
                         } // vertex read
                     case 'n':       // n indicates normal vector
                         { // normal read
                         Cartesian3 normal;
                         geometryStream >> normal;
-                        t.normals.push_back(normal);
+                        t.attributes->normals.push_back(normal);
                         break;
                         } // normal read
                     case 't':       // t indicates texture coords
                         { // tex coord
                         Cartesian3 texCoord;
                         geometryStream >> texCoord;
-                        t.textureCoords.push_back(texCoord);
+                        t.attributes->textureCoords.push_back(texCoord);
                         break;                  
                         } // tex coord
                     default:
@@ -345,9 +362,7 @@ std::vector<ThreeDModel> ThreeDModel::ReadObjectStream(std::istream &geometryStr
                 // as long as the face has at least three vertices, add to the master list
                 if (faceVertexSet.size() > 2)
                     { // at least 3
-                    t.faceVertices.push_back(faceVertexSet);
-                    t.faceNormals.push_back(faceNormalSet);
-                    t.faceTexCoords.push_back(faceTexCoordSet);
+                    t.addFace(faceVertexSet.data(), faceNormalSet.data(), faceTexCoordSet.data(), static_cast<unsigned int>(faceVertexSet.size()));
                     } // at least 3
                 
                 break;
@@ -369,6 +384,10 @@ std::vector<ThreeDModel> ThreeDModel::ReadObjectStream(std::istream &geometryStr
 // write routine
 void ThreeDModel::WriteObjectStream(std::ostream &geometryStream)
     { // WriteObjectStream()
+    const std::vector<Cartesian3> &vertices = attributes->vertices;
+    const std::vector<Cartesian3> &normals = attributes->normals;
+    const std::vector<Cartesian3> &textureCoords = attributes->textureCoords;
+
     // output the vertex coordinates
     for (unsigned int vertex = 0; vertex < vertices.size(); vertex++)
         geometryStream << "v  " << std::fixed << vertices[vertex] << std::endl;
@@ -388,17 +407,17 @@ void ThreeDModel::WriteObjectStream(std::ostream &geometryStream)
     geometryStream << std::endl;
 
     // and the faces
-    for (unsigned int face = 0; face < faceVertices.size(); face++)
+    for (unsigned int face = 0; face < faceCount(); face++)
         { // per face
         geometryStream << "f ";
         
         // loop through # of vertices
-        for (unsigned int vertex = 0; vertex < faceVertices[face].size(); vertex++)
-            geometryStream << faceVertices[face][vertex]+1 << "/" << faceTexCoords[face][vertex]+1 << "/" << faceNormals[face][vertex]+1 << " " ;
+        for (unsigned int corner = faceOffsets[face]; corner < faceOffsets[face+1]; corner++)
+            geometryStream << cornerVertices[corner]+1 << "/" << cornerTexCoords[corner]+1 << "/" << cornerNormals[corner]+1 << " " ;
         
         geometryStream << std::endl;
         } // per face
-    geometryStream << "# " << faceVertices.size() << " polygons" << std::endl;
+    geometryStream << "# " << faceCount() << " polygons" << std::endl;
     geometryStream << std::endl;
 
     } // WriteObjectStream()
@@ -468,34 +487,38 @@ void ThreeDModel::Render()
     // repeat this for colour - extra call, but saves if statements
     glColor3fv(surfaceColour);
 
+    const std::vector<Cartesian3> &vertices = attributes->vertices;
+    const std::vector<Cartesian3> &normals = attributes->normals;
+    const std::vector<Cartesian3> &textureCoords = attributes->textureCoords;
+
     // loop through the faces: note that they may not be triangles, which complicates life
-    for (unsigned int face = 0; face < faceVertices.size(); face++)
+    for (unsigned int face = 0; face < faceCount(); face++)
         { // per face        
         // on each face, treat it as a triangle fan starting with the first vertex on the face
         glBegin(GL_TRIANGLE_FAN);
-        for (unsigned int faceVertex = 0; faceVertex < faceVertices[face].size(); faceVertex++)
+        for (unsigned int corner = faceOffsets[face]; corner < faceOffsets[face+1]; corner++)
             {    // start rendering
                 // now we use that ID to lookup
                 glNormal3f
                     (
-                    normals         [faceNormals    [face][faceVertex]  ].x,
-                    normals         [faceNormals    [face][faceVertex]  ].y,
-                    normals         [faceNormals    [face][faceVertex]  ].z
+                    normals         [cornerNormals    [corner]  ].x,
+                    normals         [cornerNormals    [corner]  ].y,
+                    normals         [cornerNormals    [corner]  ].z
                     );
 
                 // set the texture coordinate
                 glTexCoord2f
                     (
-                    textureCoords   [faceTexCoords  [face][faceVertex]  ].x,
-                    textureCoords   [faceTexCoords  [face][faceVertex]  ].y
+                    textureCoords   [cornerTexCoords  [corner]  ].x,
+                    textureCoords   [cornerTexCoords  [corner]  ].y
                     );
                     
                 // and set the vertex position
                 glVertex3f
                     (
-                    vertices        [faceVertices   [face][faceVertex]].x,
-                    vertices        [faceVertices   [face][faceVertex]].y,
-                    vertices        [faceVertices   [face][faceVertex]].z
+                    vertices        [cornerVertices   [corner]].x,
+                    vertices        [cornerVertices   [corner]].y,
+                    vertices        [cornerVertices   [corner]].z
                     );
             } // per triangle
         glEnd();
@@ -30,6 +30,7 @@
 
 // include the C++ standard libraries we need for the header
 #include <vector>
+#include <memory>
 #include <iostream>
 #ifdef __APPLE__
 #include <OpenGL/gl.h>
@@ -49,26 +50,34 @@
 class RenderParameters;
 #include "RenderParameters.h"
 
-class ThreeDModel
-    { // class
+// vertex data read from one file, shared by all the models (one per material) made from it
+class MeshAttributes
+    { // class MeshAttributes
     public:
     // vector of vertices
     std::vector<Cartesian3> vertices;
 
     // vector of normals
     std::vector<Cartesian3> normals;
-    
+
     // vector of texture coordinates (stored as triple to simplify code)
     std::vector<Cartesian3> textureCoords;
+    }; // class MeshAttributes
 
-    // vector of faces
-    std::vector<std::vector<unsigned int> > faceVertices;
+class ThreeDModel
+    { // class
+    public:
+    // the vertices, normals and texture coordinates the faces refer to
+    std::shared_ptr<MeshAttributes> attributes;
 
-    // corresponding vector of normals
-    std::vector<std::vector<unsigned int> > faceNormals;
-    
-    // corresponding vector of texture coordinates
-    std::vector<std::vector<unsigned int> > faceTexCoords;
+    // the faces are stored as one flat list of corners: face f has corners faceOffsets[f]
+    // up to (but not including) faceOffsets[f+1], so there is one more offset than faces
+    std::vector<unsigned int> faceOffsets;
+
+    // for each corner, the IDs of its vertex, normal & texture coordinate in attributes
+    std::vector<unsigned int> cornerVertices;
+    std::vector<unsigned int> cornerNormals;
+    std::vector<unsigned int> cornerTexCoords;
 
     //Material that it might have
     Material *material;
@@ -78,6 +87,13 @@ class ThreeDModel
 
     // constructor will initialise to safe values
     ThreeDModel();
+
+    // number of faces, and number of corners on a face
+    unsigned int faceCount() const;
+    unsigned int faceSize(unsigned int face) const;
+
+    // add a face with the given corners (IDs are 0-based)
+    void addFace(const unsigned int *vertexIDs, const unsigned int *normalIDs, const unsigned int *texCoordIDs, unsigned int nCorners);
     
     // read routine returns true on success, failure otherwise
     static std::vector<ThreeDModel> ReadObjectStream(std::istream &geometryStream);
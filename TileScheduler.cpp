@@ -0,0 +1,63 @@
+#include "TileScheduler.h"
+#include <algorithm>
+#include <chrono>
+
+TileScheduler::TileScheduler()
+{
+    requestedThreads = 0;
+}
+
+void TileScheduler::setThreadCount(unsigned int threadCount)
+{
+    if (pool && threadCount == requestedThreads)
+        return;
+
+    requestedThreads = threadCount;
+    pool.reset(new ThreadPool(threadCount));
+}
+
+unsigned int TileScheduler::threadCount() const
+{
+    return pool ? pool->size() : 0;
+}
+
+void TileScheduler::run(int width, int height, int tileSize, const std::function<void(const Tile &)> &renderTile)
+{
+    if (!pool)
+        setThreadCount(requestedThreads);
+
+    tileSize = std::max(1, tileSize);
+
+    lastTiles.clear();
+    for (int y = 0; y < height; y += tileSize)
+    {
+        for (int x = 0; x < width; x += tileSize)
+        {
+            Tile tile;
+            tile.x = x;
+            tile.y = y;
+            tile.width = std::min(tileSize, width - x);
+            tile.height = std::min(tileSize, height - y);
+            tile.worker = 0;
+            tile.milliseconds = 0.0;
+            lastTiles.push_back(tile);
+        }
+    }
+
+    //Each task only ever touches its own tile, so the timings need no locking
+    pool->run(lastTiles.size(), [&](unsigned int task, unsigned int worker)
+    {
+        Tile &tile = lastTiles[task];
+        auto start = std::chrono::steady_clock::now();
+        renderTile(tile);
+        auto end = std::chrono::steady_clock::now();
+
+        tile.worker = worker;
+        tile.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+    });
+}
+
+const std::vector<TileScheduler::Tile> &TileScheduler::tiles() const
+{
+    return lastTiles;
+}
@@ -0,0 +1,45 @@
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include "ThreadPool.h"
+
+//Splits an image into square tiles and renders them on a work-stealing thread pool
+//Tiles keep each thread's rays close together on screen (and so in the BVH), and balance far
+//better than scanlines when some parts of the image cost much more than others
+class TileScheduler
+{
+public:
+    struct Tile
+    {
+        //Pixel rectangle covered by the tile
+        int x, y;
+        int width, height;
+
+        //Filled in once the tile is rendered: which worker rendered it and how long it took
+        unsigned int worker;
+        double milliseconds;
+    };
+
+    TileScheduler();
+
+    //0 means one thread per hardware thread. The pool is only rebuilt when the count changes
+    void setThreadCount(unsigned int threadCount);
+    unsigned int threadCount() const;
+
+    //Renders a width x height image in tiles of tileSize x tileSize pixels (smaller at the right and top edges),
+    //calling renderTile once per tile from the worker threads. Returns once every tile is done
+    void run(int width, int height, int tileSize, const std::function<void(const Tile &)> &renderTile);
+
+    //Tiles of the last run(), with their timings
+    const std::vector<Tile> &tiles() const;
+
+private:
+    std::unique_ptr<ThreadPool> pool;
+    unsigned int requestedThreads;
+    std::vector<Tile> lastTiles;
+};
+
+#endif // TILESCHEDULER_H
@@ -0,0 +1,125 @@
+#include "TileWriter.h"
+
+TileWriter::TileWriter()
+{
+    format = PPM;
+    width = 0;
+    height = 0;
+    headerLength = 0;
+    pixelSize = 0;
+    kept = false;
+}
+
+TileWriter::Format TileWriter::formatFor(const std::string &filename)
+{
+    return FloatImage::IsPFMFilename(filename) ? PFM : PPM;
+}
+
+bool TileWriter::open(const std::string &filename, Format format, long width, long height, bool resume)
+{
+    close();
+
+    this->format = format;
+    this->width = width;
+    this->height = height;
+
+    std::string header = format == PFM ? FloatImage::PFMHeader(width, height) : RGBAImage::BinaryPPMHeader(width, height);
+    headerLength = header.size();
+    pixelSize = format == PFM ? sizeof(Cartesian3) : 3;
+    std::streamoff fileSize = std::streamoff(headerLength) + std::streamoff(width) * height * pixelSize;
+
+    //An existing image can be carried on with if it has exactly the header and size this one would have
+    kept = false;
+    if (resume)
+    {
+        std::ifstream existing(filename.c_str(), std::ios::binary);
+        std::string existingHeader(header.size(), '\0');
+        if (existing.read(&existingHeader[0], existingHeader.size()) && existingHeader == header
+                && existing.seekg(0, std::ios::end) && existing.tellg() == fileSize)
+            kept = true;
+    }
+
+    if (kept)
+    {
+        file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+        return file.good();
+    }
+
+    file.open(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.good())
+        return false;
+    file.write(header.data(), header.size());
+
+    //Writing the last byte makes the file its full size, with every pixel zero, i.e. black
+    if (width > 0 && height > 0)
+    {
+        file.seekp(fileSize - 1);
+        file.put(0);
+    }
+    return file.good();
+}
+
+bool TileWriter::flush()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    file.flush();
+    return file.good();
+}
+
+bool TileWriter::close()
+{
+    if (!file.is_open())
+        return true;
+    file.flush();
+    bool good = file.good();
+    file.close();
+    return good;
+}
+
+bool TileWriter::resumed() const
+{
+    return kept;
+}
+
+std::streamoff TileWriter::offset(long row, long column) const
+{
+    //PPM files start with the top row, PFM files with the bottom one
+    long fileRow = format == PPM ? height - 1 - row : row;
+    return std::streamoff(headerLength) + (std::streamoff(fileRow) * width + column) * pixelSize;
+}
+
+void TileWriter::writeRow(long row, long column, const char *data, long count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    file.seekp(offset(row, column));
+    file.write(data, count * pixelSize);
+}
+
+void TileWriter::writeTile(const TileScheduler::Tile &tile, const RGBAImage &image, long firstRow)
+{
+    if (format != PPM)
+        return;
+
+    std::vector<unsigned char> bytes(3 * tile.width);
+    for (long row = tile.y; row < tile.y + tile.height; row++)
+    {
+        const RGBAValue *pixels = image[row] + tile.x;
+        for (long i = 0; i < tile.width; i++)
+        {
+            bytes[3 * i] = pixels[i].red;
+            bytes[3 * i + 1] = pixels[i].green;
+            bytes[3 * i + 2] = pixels[i].blue;
+        }
+        writeRow(firstRow + row, tile.x, reinterpret_cast<const char *>(bytes.data()), tile.width);
+    }
+}
+
+void TileWriter::writeTile(const TileScheduler::Tile &tile, const FloatImage &image, long firstRow)
+{
+    if (format != PFM)
+        return;
+
+    //The pixels of a row of the tile are already laid out as the file wants them
+    for (long row = tile.y; row < tile.y + tile.height; row++)
+        writeRow(firstRow + row, tile.x, reinterpret_cast<const char *>(image[row] + tile.x), tile.width);
+}
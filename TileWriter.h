@@ -0,0 +1,70 @@
+#ifndef TILEWRITER_H
+#define TILEWRITER_H
+
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include "RGBAImage.h"
+#include "FloatImage.h"
+#include "TileScheduler.h"
+
+//Streams an image into a binary PPM (P6) or PFM file a tile at a time, e.g. as the render threads finish them,
+//so the file fills in while the render runs instead of being written in one go at the end
+//Both formats have a fixed size header and fixed size pixels, so every row of a tile goes straight to its place in the file,
+//one write per row. Rows are taken bottom first, as in the frame buffer, and flipped for PPM, which is stored top first
+//Nothing but the row being written is held in memory, so the file can be far larger than the memory (see BandedRender)
+class TileWriter
+{
+public:
+    enum Format
+    {
+        PPM,
+        PFM
+    };
+
+    TileWriter();
+
+    TileWriter(const TileWriter &) = delete;
+    TileWriter &operator=(const TileWriter &) = delete;
+
+    //Creates (or replaces) filename as a black width x height image. Returns false if it cannot be written
+    //With resume, a file that already holds an image of this format and size is kept as it is instead, and resumed() returns true
+    bool open(const std::string &filename, Format format, long width, long height, bool resume = false);
+    //Hands everything written so far over to the operating system, so it reaches the file even if the program is killed;
+    //returns false if any write failed
+    bool flush();
+    //Flushes and closes the file; returns false if any write failed
+    bool close();
+
+    //Whether open() kept an existing image
+    bool resumed() const;
+
+    //The format a filename asks for: PFM for .pfm, otherwise PPM
+    static Format formatFor(const std::string &filename);
+
+    //Write the pixels of tile, taken from an image (tone mapped for PPM, radiance for PFM) as wide as the file,
+    //whose row 0 is row firstRow of the file (counted from the bottom), i.e. the whole image or a band of it
+    //Safe to call from several threads at once
+    void writeTile(const TileScheduler::Tile &tile, const RGBAImage &image, long firstRow = 0);
+    void writeTile(const TileScheduler::Tile &tile, const FloatImage &image, long firstRow = 0);
+
+private:
+    std::fstream file;
+    //Serialises the seeks and writes of different threads
+    std::mutex mutex;
+    Format format;
+    long width, height;
+    //Where the pixels start, and the size of one
+    long headerLength;
+    long pixelSize;
+    bool kept;
+
+    //Where a pixel is in the file; 64 bit, since a large PFM can be many gigabytes
+    std::streamoff offset(long row, long column) const;
+
+    //Writes count pixels of packed data for row of the image (counted from the bottom) starting at column
+    void writeRow(long row, long column, const char *data, long count);
+};
+
+#endif // TILEWRITER_H
@@ -0,0 +1,93 @@
+#include "ToneMapper.h"
+#include <math.h>
+#include <cstring>
+#include <algorithm>
+
+//Gamma of the display the images are meant for
+#define DISPLAY_GAMMA 2.2f
+//Number of output levels, a power of two so that the table can be searched by halving
+#define OUTPUT_LEVELS 256
+
+namespace
+{
+    //The level that gamma correcting value and converting it to 8 bits gives, the way the renderer always did it
+    unsigned char directLevel(float value)
+    {
+        return RGBAValue(pow(value, 1 / DISPLAY_GAMMA) * 255.0f, 0.0f, 0.0f, 0.0f).red;
+    }
+
+    //thresholds[level] is the smallest value that comes out at that level or higher (thresholds[0] is never used)
+    struct GammaTable
+    {
+        float thresholds[OUTPUT_LEVELS];
+
+        GammaTable()
+        {
+            thresholds[0] = 0.0f;
+            for (unsigned int level = 1; level < OUTPUT_LEVELS; level++)
+            {
+                //Non-negative floats sort in the same order as their bit patterns, so the threshold can be found
+                //by bisecting on those, which lands on it exactly
+                unsigned int low = 0;
+                unsigned int high = 0x3f800000; //1.0f, which always gives the top level
+                while (low < high)
+                {
+                    unsigned int middle = low + (high - low) / 2;
+                    float value;
+                    std::memcpy(&value, &middle, sizeof(value));
+                    if (directLevel(value) >= level)
+                        high = middle;
+                    else
+                        low = middle + 1;
+                }
+                std::memcpy(&thresholds[level], &low, sizeof(float));
+            }
+        }
+    };
+
+    const GammaTable &gammaTable()
+    {
+        //Built on first use; the initialisation of a function's statics is thread safe
+        static const GammaTable table;
+        return table;
+    }
+}
+
+ToneMapper::ToneMapper(float exposure, Curve curve)
+{
+    scale = pow(2.0f, exposure);
+    this->curve = curve;
+
+    //Make sure the table is built before any render threads need it
+    gammaTable();
+}
+
+unsigned char ToneMapper::gammaLevel(float value)
+{
+    const float *thresholds = gammaTable().thresholds;
+
+    //Binary search for the highest level whose threshold value reaches; NaNs and negative values stay black
+    unsigned int level = 0;
+    for (unsigned int step = OUTPUT_LEVELS / 2; step > 0; step /= 2)
+        if (value >= thresholds[level + step])
+            level += step;
+    return level;
+}
+
+RGBAValue ToneMapper::map(const Cartesian3 &radiance) const
+{
+    Cartesian3 exposed = radiance * scale;
+    if (curve == Reinhard)
+        exposed = Cartesian3(exposed.x / (1.0f + exposed.x), exposed.y / (1.0f + exposed.y), exposed.z / (1.0f + exposed.z));
+
+    return RGBAValue(gammaLevel(exposed.x), gammaLevel(exposed.y), gammaLevel(exposed.z), (unsigned char) 255);
+}
+
+float ToneMapper::brightness(const Cartesian3 &radiance) const
+{
+    Cartesian3 exposed = radiance * scale;
+    float luminance = 0.2126f * exposed.x + 0.7152f * exposed.y + 0.0722f * exposed.z;
+    if (curve == Reinhard)
+        luminance = luminance / (1.0f + luminance);
+    return pow(std::min(1.0f, std::max(0.0f, luminance)), 1 / DISPLAY_GAMMA);
+}
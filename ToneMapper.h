@@ -0,0 +1,38 @@
+#ifndef TONEMAPPER_H
+#define TONEMAPPER_H
+
+#include "Cartesian3.h"
+#include "RGBAValue.h"
+
+//Turns the linear radiance that the tracers add up into the gamma corrected 8 bit colours that are shown and saved
+//Exposure scales the radiance first (in stops, so +1 doubles it), then a tone curve brings it into [0, 1]:
+//either clipping, as the renderer always has, or Reinhard's x / (1 + x), which keeps the detail in lights and highlights
+//Gamma correction looks the result up in a table of the thresholds between the 256 output levels, in 8 steps,
+//which gives exactly the levels pow(x, 1 / 2.2) * 255 would without a pow() for every channel
+class ToneMapper
+{
+public:
+    enum Curve
+    {
+        Clip,
+        Reinhard
+    };
+
+    ToneMapper(float exposure = 0.0f, Curve curve = Clip);
+
+    RGBAValue map(const Cartesian3 &radiance) const;
+
+    //Brightness of radiance as it would appear on screen, between 0 and 1: the luminance, exposed,
+    //put through the tone curve and gamma corrected, e.g. for judging when a pixel has settled
+    float brightness(const Cartesian3 &radiance) const;
+
+    //The 8 bit level for a value after the tone curve, where 0 is black and 1 (or more) is white
+    static unsigned char gammaLevel(float value);
+
+private:
+    //2 to the power of the exposure
+    float scale;
+    Curve curve;
+};
+
+#endif // TONEMAPPER_H
@@ -0,0 +1,169 @@
+#include "TopLevelBVH.h"
+#include "Bounds.h"
+#include <algorithm>
+
+//Refitting rebuilds the tree once its boxes add up to this many times their area when it was built
+#define TOP_LEVEL_REFIT_LIMIT 2.0f
+
+namespace
+{
+    bool isEmpty(const Cartesian3 &boundsMin, const Cartesian3 &boundsMax)
+    {
+        return boundsMin.x > boundsMax.x || boundsMin.y > boundsMax.y || boundsMin.z > boundsMax.z;
+    }
+}
+
+TopLevelBVH::TopLevelBVH()
+{
+    builtArea = 0.0f;
+}
+
+bool TopLevelBVH::empty() const
+{
+    return nodes.empty();
+}
+
+void TopLevelBVH::build(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax)
+{
+    nodes.clear();
+    items.clear();
+    itemsMin.clear();
+    itemsMax.clear();
+    centroids.assign(boundsMin.size(), Cartesian3());
+
+    for (unsigned int i = 0; i < boundsMin.size(); i++)
+    {
+        if (isEmpty(boundsMin[i], boundsMax[i]))
+            continue;
+        items.push_back(i);
+        centroids[i] = (boundsMin[i] + boundsMax[i]) * 0.5f;
+    }
+
+    if (items.empty())
+    {
+        builtArea = 0.0f;
+        return;
+    }
+
+    //A binary tree never has more than 2n - 1 nodes for n items
+    nodes.reserve(2 * items.size() - 1);
+
+    Node root;
+    root.leftOrFirst = 0;
+    root.count = items.size();
+    nodes.push_back(root);
+
+    subdivide(0, 0);
+    std::vector<Cartesian3>().swap(centroids);
+
+    fitBounds(boundsMin, boundsMax);
+
+    builtArea = totalArea();
+}
+
+void TopLevelBVH::subdivide(unsigned int nodeIndex, int depth)
+{
+    if (nodes[nodeIndex].count <= TOP_LEVEL_LEAF_SIZE || depth >= TOP_LEVEL_MAX_DEPTH)
+        return;
+
+    unsigned int first = nodes[nodeIndex].leftOrFirst;
+    unsigned int count = nodes[nodeIndex].count;
+
+    //Split at the median along the axis over which the centres of the boxes are most spread out
+    Cartesian3 centroidMin = centroids[items[first]];
+    Cartesian3 centroidMax = centroidMin;
+    for (unsigned int i = first + 1; i < first + count; i++)
+    {
+        centroidMin = minimum(centroidMin, centroids[items[i]]);
+        centroidMax = maximum(centroidMax, centroids[items[i]]);
+    }
+    Cartesian3 extent = centroidMax - centroidMin;
+    int axis = 0;
+    if (extent.y > extent.x)
+        axis = 1;
+    if (extent.z > extent[axis])
+        axis = 2;
+
+    unsigned int half = count / 2;
+    std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+                     [this, axis](unsigned int a, unsigned int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    //The children go at the end, so every node comes before its children (refit() relies on this)
+    unsigned int left = nodes.size();
+    Node child;
+    child.leftOrFirst = first;
+    child.count = half;
+    nodes.push_back(child);
+    child.leftOrFirst = first + half;
+    child.count = count - half;
+    nodes.push_back(child);
+
+    nodes[nodeIndex].leftOrFirst = left;
+    nodes[nodeIndex].count = 0;
+
+    subdivide(left, depth + 1);
+    subdivide(left + 1, depth + 1);
+}
+
+void TopLevelBVH::refit(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax)
+{
+    //The tree has to be built again if the set of non-empty boxes has changed
+    unsigned int nonEmpty = 0;
+    for (unsigned int i = 0; i < boundsMin.size(); i++)
+        if (!isEmpty(boundsMin[i], boundsMax[i]))
+            nonEmpty++;
+    bool changed = nonEmpty != items.size();
+    for (unsigned int i = 0; i < items.size() && !changed; i++)
+        changed = items[i] >= boundsMin.size() || isEmpty(boundsMin[items[i]], boundsMax[items[i]]);
+    if (changed)
+    {
+        build(boundsMin, boundsMax);
+        return;
+    }
+
+    fitBounds(boundsMin, boundsMax);
+
+    //Boxes that have moved a long way apart leave big, overlapping nodes, which slow every ray down
+    if (totalArea() > TOP_LEVEL_REFIT_LIMIT * builtArea)
+        build(boundsMin, boundsMax);
+}
+
+void TopLevelBVH::fitBounds(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax)
+{
+    itemsMin.resize(items.size());
+    itemsMax.resize(items.size());
+    for (unsigned int i = 0; i < items.size(); i++)
+    {
+        itemsMin[i] = boundsMin[items[i]];
+        itemsMax[i] = boundsMax[items[i]];
+    }
+
+    //Children always come after their parents, so walking backwards sets their boxes first
+    for (unsigned int n = nodes.size(); n-- > 0;)
+    {
+        Node &node = nodes[n];
+        if (node.count > 0)
+        {
+            node.boundsMin = itemsMin[node.leftOrFirst];
+            node.boundsMax = itemsMax[node.leftOrFirst];
+            for (unsigned int i = node.leftOrFirst + 1; i < node.leftOrFirst + node.count; i++)
+            {
+                node.boundsMin = minimum(node.boundsMin, itemsMin[i]);
+                node.boundsMax = maximum(node.boundsMax, itemsMax[i]);
+            }
+        }
+        else
+        {
+            node.boundsMin = minimum(nodes[node.leftOrFirst].boundsMin, nodes[node.leftOrFirst + 1].boundsMin);
+            node.boundsMax = maximum(nodes[node.leftOrFirst].boundsMax, nodes[node.leftOrFirst + 1].boundsMax);
+        }
+    }
+}
+
+float TopLevelBVH::totalArea() const
+{
+    float area = 0.0f;
+    for (const Node &node : nodes)
+        area += surfaceArea(node.boundsMin, node.boundsMax);
+    return area;
+}
@@ -0,0 +1,209 @@
+#ifndef TOPLEVELBVH_H
+#define TOPLEVELBVH_H
+
+#include <vector>
+#include "Cartesian3.h"
+#include "Ray.h"
+#include "BVH.h"
+
+//Deepest level of the tree, which also bounds the traversal stack
+//Median splits halve the items at every level, so this is never reached in practice
+#define TOP_LEVEL_MAX_DEPTH 64
+//Leaves are never split below this many items; a leaf tests each of its items' boxes in turn,
+//which for a handful of items is cheaper than walking more nodes
+#define TOP_LEVEL_LEAF_SIZE 4
+
+//The top level of a two-level acceleration structure: a BVH over the boxes of the instances in a scene,
+//each of which has its own (bottom level) BVH over its triangles in object space
+//Moving instances only needs refit(), which updates the boxes of the tree it already has;
+//it is built again when instances are added or removed, or when refitting has made it too loose
+class TopLevelBVH
+{
+public:
+    struct Node
+    {
+        Cartesian3 boundsMin;
+        Cartesian3 boundsMax;
+
+        //Interior node: index of the left child (the right child is always stored next to it)
+        //Leaf node: index of its first entry in items
+        unsigned int leftOrFirst;
+
+        //Number of items in a leaf, 0 for an interior node
+        unsigned int count;
+    };
+
+    std::vector<Node> nodes;
+
+    //Indices of the boxes the tree was built over, in leaf order, and the boxes themselves in the same order
+    std::vector<unsigned int> items;
+    std::vector<Cartesian3> itemsMin;
+    std::vector<Cartesian3> itemsMax;
+
+    TopLevelBVH();
+
+    //Builds the tree over a list of boxes, leaving out any that are empty (with min > max)
+    void build(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax);
+
+    //Updates the tree for boxes that have moved, keeping its shape
+    //The boxes must be the same ones it was built over; if the tree has grown much looser
+    //than when it was built (or boxes have become empty or non-empty) it is built again instead
+    void refit(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax);
+
+    bool empty() const;
+
+    //Calls visit(item) for each item whose box r enters closer than tMax, roughly nearest first
+    //visit may lower tMax (e.g. when it finds a hit), and returns true to end the walk early
+    template <class Visit>
+    void traverse(const Ray &r, float &tMax, Visit visit) const;
+
+    //As traverse(), for BVH_PACKET_SIZE rays with a tMax each
+    //visit(item) is called once for the whole packet when any ray reaches the item's box
+    template <class Visit>
+    void traversePacket(const Ray *rays, float *tMax, Visit visit) const;
+
+private:
+    //Sum of the node surface areas when the tree was last built, to tell how far refitting has loosened it
+    float builtArea;
+
+    //Centroids of the boxes, only needed while building
+    std::vector<Cartesian3> centroids;
+
+    void subdivide(unsigned int nodeIndex, int depth);
+    //Sets the box of every node from the boxes of the items below it
+    void fitBounds(const std::vector<Cartesian3> &boundsMin, const std::vector<Cartesian3> &boundsMax);
+    float totalArea() const;
+};
+
+template <class Visit>
+void TopLevelBVH::traverse(const Ray &r, float &tMax, Visit visit) const
+{
+    if (nodes.empty())
+        return;
+
+    Cartesian3 inverseDirection(1.0f / r.direction.x, 1.0f / r.direction.y, 1.0f / r.direction.z);
+
+    struct StackEntry
+    {
+        unsigned int node;
+        float tNear;
+    };
+    StackEntry stack[TOP_LEVEL_MAX_DEPTH + 1];
+    int stackSize = 0;
+
+    float tRoot = BVH::intersectBox(nodes[0].boundsMin, nodes[0].boundsMax, r.origin, inverseDirection, tMax);
+    if (tRoot >= 0)
+        stack[stackSize++] = {0, tRoot};
+
+    while (stackSize > 0)
+    {
+        StackEntry entry = stack[--stackSize];
+
+        //A closer hit may have been found since this node was pushed
+        if (entry.tNear > tMax)
+            continue;
+
+        const Node &node = nodes[entry.node];
+
+        if (node.count > 0)
+        {
+            for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+                if (BVH::intersectBox(itemsMin[i], itemsMax[i], r.origin, inverseDirection, tMax) >= 0 && visit(items[i]))
+                    return;
+            continue;
+        }
+
+        //Visit the nearer child first, so tMax shrinks as early as possible
+        unsigned int left = node.leftOrFirst;
+        unsigned int right = left + 1;
+        float tLeft = BVH::intersectBox(nodes[left].boundsMin, nodes[left].boundsMax, r.origin, inverseDirection, tMax);
+        float tRight = BVH::intersectBox(nodes[right].boundsMin, nodes[right].boundsMax, r.origin, inverseDirection, tMax);
+
+        if (tLeft >= 0 && tRight >= 0)
+        {
+            if (tLeft <= tRight)
+            {
+                stack[stackSize++] = {right, tRight};
+                stack[stackSize++] = {left, tLeft};
+            }
+            else
+            {
+                stack[stackSize++] = {left, tLeft};
+                stack[stackSize++] = {right, tRight};
+            }
+        }
+        else if (tLeft >= 0)
+            stack[stackSize++] = {left, tLeft};
+        else if (tRight >= 0)
+            stack[stackSize++] = {right, tRight};
+    }
+}
+
+template <class Visit>
+void TopLevelBVH::traversePacket(const Ray *rays, float *tMax, Visit visit) const
+{
+    if (nodes.empty())
+        return;
+
+    Cartesian3 inverseDirections[BVH_PACKET_SIZE];
+    for (int k = 0; k < BVH_PACKET_SIZE; k++)
+        inverseDirections[k] = Cartesian3(1.0f / rays[k].direction.x, 1.0f / rays[k].direction.y, 1.0f / rays[k].direction.z);
+
+    //Nearest entry of any ray of the packet into a box, or a negative value if none of them reaches it
+    auto nearestEntry = [&](const Cartesian3 &boundsMin, const Cartesian3 &boundsMax)
+    {
+        float nearest = -1.0f;
+        for (int k = 0; k < BVH_PACKET_SIZE; k++)
+        {
+            float t = BVH::intersectBox(boundsMin, boundsMax, rays[k].origin, inverseDirections[k], tMax[k]);
+            if (t >= 0 && (nearest < 0 || t < nearest))
+                nearest = t;
+        }
+        return nearest;
+    };
+
+    unsigned int stack[TOP_LEVEL_MAX_DEPTH + 1];
+    int stackSize = 0;
+
+    if (nearestEntry(nodes[0].boundsMin, nodes[0].boundsMax) >= 0)
+        stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Node &node = nodes[stack[--stackSize]];
+
+        if (node.count > 0)
+        {
+            //The rays may have found closer hits since this node was pushed, so each box is tested again
+            for (unsigned int i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+                if (nearestEntry(itemsMin[i], itemsMax[i]) >= 0 && visit(items[i]))
+                    return;
+            continue;
+        }
+
+        unsigned int left = node.leftOrFirst;
+        unsigned int right = left + 1;
+        float tLeft = nearestEntry(nodes[left].boundsMin, nodes[left].boundsMax);
+        float tRight = nearestEntry(nodes[right].boundsMin, nodes[right].boundsMax);
+
+        if (tLeft >= 0 && tRight >= 0)
+        {
+            if (tLeft <= tRight)
+            {
+                stack[stackSize++] = right;
+                stack[stackSize++] = left;
+            }
+            else
+            {
+                stack[stackSize++] = left;
+                stack[stackSize++] = right;
+            }
+        }
+        else if (tLeft >= 0)
+            stack[stackSize++] = left;
+        else if (tRight >= 0)
+            stack[stackSize++] = right;
+    }
+}
+
+#endif // TOPLEVELBVH_H
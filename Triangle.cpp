@@ -7,128 +7,7 @@ Triangle::Triangle()
     shared_material = nullptr;
 }
 
-float Triangle::intersect(Ray r)
-{
-    //Triangle vertices (Capital letters to avoid confusion with Ray r)
-    Cartesian3 P = verts[0].Point();
-    Cartesian3 Q = verts[1].Point();
-    Cartesian3 R = verts[2].Point();
-
-    //Construct vectors
-    Cartesian3 u = Q - P;
-    Cartesian3 v = R - P;
-
-    //Normalise u -> divide by its norm
-    u = u.unit();
-
-    //Compute n -> cross product between u and v and normalise
-    Cartesian3 n = u.cross(v).unit();
-
-    //Compute w - > cross product between n and u and normalise
-    Cartesian3 w = n.cross(u).unit();
-
-    //Find the value of t
-    float t = ((P - r.origin).dot(n) / r.direction.dot(n));
-
-    //Before returning t, we want to make sure it is a valid intersection
-    //Calculate point o and convert to PCS
-    Cartesian3 o = r.origin +  r.direction*t;
-    Cartesian3 oPCS = {(o-P).dot(u), (o-P).dot(w), (o-P).dot(n)};
-
-    //Converting p,q and r to planar coordinates
-    Cartesian3 pPCS = {(P-P).dot(u), (P-P).dot(w), (P-P).dot(n)};
-    Cartesian3 qPCS = {(Q-P).dot(u), (Q-P).dot(w), (Q-P).dot(n)};
-    Cartesian3 rPCS = {(R-P).dot(u), (R-P).dot(w), (R-P).dot(n)};
-
-    //Creating edges to the planar coordiantes
-    Cartesian3 rpPCS = rPCS - pPCS;
-    Cartesian3 pqPCS = pPCS - qPCS;
-    Cartesian3 qrPCS = qPCS - rPCS;
-
-    //We can now perform a 2D half plane test, checking that point o is within pqr
-    //Get the normal form of the 2D triangle coordinates
-    Cartesian3 rpNorm = {-rpPCS.y, rpPCS.x, 0};
-    Cartesian3 pqNorm = {-pqPCS.y, pqPCS.x, 0};
-    Cartesian3 qrNorm = {-qrPCS.y, qrPCS.x, 0};
-
-    //Use the half plane test to check that the intersection is within the triangle
-    double test1 = rpNorm.dot((oPCS - pPCS));
-    double test2 = pqNorm.dot((oPCS - qPCS));
-    double test3 = qrNorm.dot((oPCS - rPCS));                                                                                                           ;
-
-    if(test1 <= 0.00002 && test2 <= 0.00002 && test3 <= 0.00002)
-    {
-        return t;
-    }
-
-    //If not, then the point is not inside the triangle
-    return -1;
-
-}
-
-Cartesian3 Triangle::barycentric(Cartesian3 o)
-{
-    //Triangle vertices (Capital letters to avoid confusion with Ray r)
-    Cartesian3 P = verts[0].Point();
-    Cartesian3 Q = verts[1].Point();
-    Cartesian3 R = verts[2].Point();
-
-    //Construct vectors
-    Cartesian3 u = Q - P;
-    Cartesian3 v = R - P;
-
-    //Normalise u -> divide by its norm
-    u = u.unit();
-
-    //Compute n -> cross product between u and v and normalise
-    Cartesian3 n = u.cross(v).unit();
-
-    //Compute w - > cross product between n and u and normalise
-    Cartesian3 w = n.cross(u).unit();
-
-    //Converting o, p, q and r to planar coordinates
-    Cartesian3 oPCS = {(o-P).dot(u), (o-P).dot(w), (o-P).dot(n)};
-    Cartesian3 pPCS = {(P-P).dot(u), (P-P).dot(w), (P-P).dot(n)};
-    Cartesian3 qPCS = {(Q-P).dot(u), (Q-P).dot(w), (Q-P).dot(n)};
-    Cartesian3 rPCS = {(R-P).dot(u), (R-P).dot(w), (R-P).dot(n)};
-
-    //Create edges and form normals from them
-    Cartesian3 rp = rPCS - pPCS;
-    Cartesian3 qr = qPCS - rPCS;
-    Cartesian3 pq = pPCS - qPCS;
-
-    Cartesian3 rpNorm = {-rp.y, rp.x, 0};
-    Cartesian3 qrNorm = {-qr.y, qr.x, 0};
-    Cartesian3 pqNorm = {-pq.y, pq.x, 0};
-
-    //Calculate distances
-    float distOtoRP, distOtoQR, distOtoPQ;
-    float distQtoRP, distPtoQR, distRtoPQ;
-
-    //Calculate the distances from each edge to o
-    distOtoRP = (rpNorm.dot(pPCS - oPCS)) / rpNorm.length();
-    distOtoQR = (qrNorm.dot(rPCS - oPCS)) / qrNorm.length();
-    distOtoPQ = (pqNorm.dot(qPCS - oPCS)) / pqNorm.length();
-
-    //Calculate the distance between each vertex and their opposite edge
-    distPtoQR = (qrNorm.dot(rp)) / qrNorm.length();
-    distQtoRP = (rpNorm.dot(pq)) / rpNorm.length();
-    distRtoPQ = (pqNorm.dot(qr)) / pqNorm.length();
-
-    //Calculate barycentric coordinates
-    float alpha = distOtoQR / distPtoQR;
-    float beta = distOtoRP / distQtoRP;
-    float gamma = distOtoPQ / distRtoPQ;
-
-    Cartesian3 bc;
-    bc.x = alpha;
-    bc.y = beta;
-    bc.z = gamma;
-
-    return bc;
-}
-
-Homogeneous4 Triangle::calculatePhong(Homogeneous4 lightPosition, Homogeneous4 lightColour, Cartesian3 barycentricCoords, bool inShadow)
+Homogeneous4 Triangle::calculatePhong(const Homogeneous4 &lightPosition, const Homogeneous4 &lightColour, const Cartesian3 &eye, const Cartesian3 &barycentricCoords, float visibility) const
 {
     //Set up the point p
     Cartesian3 P = verts[0].Point();
@@ -139,8 +18,6 @@ Homogeneous4 Triangle::calculatePhong(Homogeneous4 lightPosition, Homogeneous4 l
     Cartesian3 p = (P * barycentricCoords.x) + (Q * barycentricCoords.y) + (R * barycentricCoords.z);
     Cartesian3 normal = (normals[0].Vector()* barycentricCoords.x) + (normals[1].Vector() * barycentricCoords.y) + (normals[2].Vector() * barycentricCoords.z);
     normal = normal.unit();
-    //We know lightPosition, and eye = (0,0,0)
-    Cartesian3 eye = {0,0,0};
 
     //Set up vectors to the point from the light source, and from the eye
     //Don't normalise vl yet since we want its distance for quadratic attenuation calculation
@@ -191,13 +68,9 @@ Homogeneous4 Triangle::calculatePhong(Homogeneous4 lightPosition, Homogeneous4 l
 
     }
 
-    //If the point is in shadow, then we set specular and diffuse to 0
-    if (inShadow)
-    {
-        specular = {0,0,0};
-        diffuse = {0,0,0};
-
-    }
+    //Only the part of the light the point can see lights it directly: none of it in full shadow, some in the penumbra
+    specular = visibility * specular;
+    diffuse = visibility * diffuse;
 
 
     //Compute the total light for the point
@@ -209,3 +82,38 @@ Homogeneous4 Triangle::calculatePhong(Homogeneous4 lightPosition, Homogeneous4 l
     return phong;
 }
 
+CompactTriangle::CompactTriangle()
+{
+}
+
+CompactTriangle::CompactTriangle(const Cartesian3 &P, const Cartesian3 &Q, const Cartesian3 &R)
+{
+    v0 = P;
+    edge1 = Q - P;
+    edge2 = R - P;
+}
+
+bool CompactTriangle::intersect(const Ray &r, float &t, float &u, float &v) const
+{
+    //The determinant is zero when the ray is parallel to the triangle's plane (or the triangle is degenerate)
+    Cartesian3 p = r.direction.cross(edge2);
+    float determinant = edge1.dot(p);
+    if (std::fabs(determinant) < DETERMINANT_EPSILON)
+        return false;
+
+    float inverseDeterminant = 1.0f / determinant;
+
+    //Solve for the barycentric coordinates, bailing out as soon as the point is outside the triangle
+    Cartesian3 s = r.origin - v0;
+    u = s.dot(p) * inverseDeterminant;
+    if (u < -BARYCENTRIC_TOLERANCE || u > 1.0f + BARYCENTRIC_TOLERANCE)
+        return false;
+
+    Cartesian3 q = s.cross(edge1);
+    v = r.direction.dot(q) * inverseDeterminant;
+    if (v < -BARYCENTRIC_TOLERANCE || u + v > 1.0f + BARYCENTRIC_TOLERANCE)
+        return false;
+
+    t = edge2.dot(q) * inverseDeterminant;
+    return t > 0.0f;
+}
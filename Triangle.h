@@ -5,6 +5,12 @@
 #include "Material.h"
 #include "Ray.h"
 
+//Shared by CompactTriangle::intersect and the TriangleBlock kernels, which must agree to the bit
+//Slack allowed on the barycentric coordinates, so rays can't slip through the shared edge of two triangles
+#define BARYCENTRIC_TOLERANCE 0.00001f
+//Determinants smaller than this mean the ray is parallel to the triangle (or the triangle is degenerate)
+#define DETERMINANT_EPSILON 1e-12f
+
 class Triangle
 {
 public:
@@ -16,10 +22,24 @@ public:
     Material *shared_material;
     Triangle();
 
-    float intersect(Ray r);
-    Cartesian3 barycentric(Cartesian3 o);
+    //Blinn-Phong lighting at a point of the triangle, seen from eye (in the same space as the triangle)
+    Homogeneous4 calculatePhong(const Homogeneous4 &lightPosition, const Homogeneous4 &lightColour, const Cartesian3 &eye, const Cartesian3 &barycentricCoords, float visibility) const;
+};
+
+//The part of a triangle that ray tests need, precomputed once by the Scene
+//At 36 bytes this is a fraction of a Triangle, so the intersection loop reads far less memory
+class CompactTriangle
+{
+public:
+    Cartesian3 v0;
+    Cartesian3 edge1;
+    Cartesian3 edge2;
+
+    CompactTriangle();
+    CompactTriangle(const Cartesian3 &P, const Cartesian3 &Q, const Cartesian3 &R);
 
-    Homogeneous4 calculatePhong(Homogeneous4 lightPosition, Homogeneous4 lightColour, Cartesian3 barycentricCoords, bool inShadow);
+    //Moller-Trumbore test: on a hit returns true with the distance t and the barycentric weights u, v of Q and R
+    bool intersect(const Ray &r, float &t, float &u, float &v) const;
 };
 
 #endif // TRIANGLE_H
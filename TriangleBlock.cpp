@@ -0,0 +1,283 @@
+#include "TriangleBlock.h"
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define TRIANGLE_BLOCK_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    //Each kernel writes t, u, v for every lane and returns a bit mask of the lanes hit at 0 < t <= tMax
+    typedef int (*IntersectFunction)(const TriangleBlock &, const Ray &, float, float *, float *, float *);
+
+    //Picks the closest of the lanes flagged in mask, with the same tie-breaking as the scalar code
+    inline bool pickClosest(int mask, const float *t, const float *u, const float *v, const unsigned int *index,
+                            float &tBest, float &uBest, float &vBest, unsigned int &indexBest)
+    {
+        bool found = false;
+        for (int lane = 0; mask != 0; lane++, mask >>= 1)
+        {
+            if (!(mask & 1))
+                continue;
+
+            if (t[lane] < tBest || (t[lane] == tBest && index[lane] < indexBest))
+            {
+                tBest = t[lane];
+                uBest = u[lane];
+                vBest = v[lane];
+                indexBest = index[lane];
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    int intersectScalar(const TriangleBlock &b, const Ray &r, float tMax, float *tLanes, float *uLanes, float *vLanes)
+    {
+        int mask = 0;
+        const Cartesian3 &o = r.origin;
+        const Cartesian3 &d = r.direction;
+
+        for (int lane = 0; lane < TRIANGLE_BLOCK_SIZE; lane++)
+        {
+            //Same operations, in the same order, as CompactTriangle::intersect
+            float px = d.y * b.e2z[lane] - d.z * b.e2y[lane];
+            float py = d.z * b.e2x[lane] - d.x * b.e2z[lane];
+            float pz = d.x * b.e2y[lane] - d.y * b.e2x[lane];
+            float determinant = b.e1x[lane] * px + b.e1y[lane] * py + b.e1z[lane] * pz;
+            if (std::fabs(determinant) < DETERMINANT_EPSILON)
+                continue;
+
+            float inverseDeterminant = 1.0f / determinant;
+
+            float sx = o.x - b.v0x[lane];
+            float sy = o.y - b.v0y[lane];
+            float sz = o.z - b.v0z[lane];
+            float u = (sx * px + sy * py + sz * pz) * inverseDeterminant;
+            if (u < -BARYCENTRIC_TOLERANCE || u > 1.0f + BARYCENTRIC_TOLERANCE)
+                continue;
+
+            float qx = sy * b.e1z[lane] - sz * b.e1y[lane];
+            float qy = sz * b.e1x[lane] - sx * b.e1z[lane];
+            float qz = sx * b.e1y[lane] - sy * b.e1x[lane];
+            float v = (d.x * qx + d.y * qy + d.z * qz) * inverseDeterminant;
+            if (v < -BARYCENTRIC_TOLERANCE || u + v > 1.0f + BARYCENTRIC_TOLERANCE)
+                continue;
+
+            float t = (b.e2x[lane] * qx + b.e2y[lane] * qy + b.e2z[lane] * qz) * inverseDeterminant;
+            if (!(t > 0.0f) || t > tMax)
+                continue;
+
+            tLanes[lane] = t;
+            uLanes[lane] = u;
+            vLanes[lane] = v;
+            mask |= 1 << lane;
+        }
+        return mask;
+    }
+
+#ifdef TRIANGLE_BLOCK_X86
+    //SSE2 is part of every x86-64 CPU, so this needs no special target
+    int intersectSSE(const TriangleBlock &b, const Ray &r, float tMax, float *tLanes, float *uLanes, float *vLanes)
+    {
+        const __m128 dx = _mm_set1_ps(r.direction.x), dy = _mm_set1_ps(r.direction.y), dz = _mm_set1_ps(r.direction.z);
+        const __m128 ox = _mm_set1_ps(r.origin.x), oy = _mm_set1_ps(r.origin.y), oz = _mm_set1_ps(r.origin.z);
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 epsilon = _mm_set1_ps(DETERMINANT_EPSILON);
+        const __m128 lower = _mm_set1_ps(-BARYCENTRIC_TOLERANCE);
+        const __m128 upper = _mm_set1_ps(1.0f + BARYCENTRIC_TOLERANCE);
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 zero = _mm_setzero_ps();
+
+        int hits = 0;
+        for (int half = 0; half < TRIANGLE_BLOCK_SIZE; half += 4)
+        {
+            __m128 e1x = _mm_load_ps(b.e1x + half), e1y = _mm_load_ps(b.e1y + half), e1z = _mm_load_ps(b.e1z + half);
+            __m128 e2x = _mm_load_ps(b.e2x + half), e2y = _mm_load_ps(b.e2y + half), e2z = _mm_load_ps(b.e2z + half);
+
+            __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            __m128 determinant = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+            __m128 mask = _mm_cmpge_ps(_mm_andnot_ps(signMask, determinant), epsilon);
+            if (_mm_movemask_ps(mask) == 0)
+                continue;
+
+            __m128 inverseDeterminant = _mm_div_ps(one, determinant);
+
+            __m128 sx = _mm_sub_ps(ox, _mm_load_ps(b.v0x + half));
+            __m128 sy = _mm_sub_ps(oy, _mm_load_ps(b.v0y + half));
+            __m128 sz = _mm_sub_ps(oz, _mm_load_ps(b.v0z + half));
+            __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDeterminant);
+            mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, lower), _mm_cmple_ps(u, upper)));
+
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDeterminant);
+            mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, lower), _mm_cmple_ps(_mm_add_ps(u, v), upper)));
+
+            __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDeterminant);
+            mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+            mask = _mm_and_ps(mask, _mm_cmple_ps(t, _mm_set1_ps(tMax)));
+
+            int bits = _mm_movemask_ps(mask);
+            if (bits == 0)
+                continue;
+
+            _mm_store_ps(tLanes + half, t);
+            _mm_store_ps(uLanes + half, u);
+            _mm_store_ps(vLanes + half, v);
+            hits |= bits << half;
+        }
+        return hits;
+    }
+
+    //Compiled for AVX2 only (not FMA), so the compiler can't fuse the multiply-adds and change the rounding
+    __attribute__((target("avx2")))
+    int intersectAVX2(const TriangleBlock &b, const Ray &r, float tMax, float *tLanes, float *uLanes, float *vLanes)
+    {
+        const __m256 dx = _mm256_set1_ps(r.direction.x), dy = _mm256_set1_ps(r.direction.y), dz = _mm256_set1_ps(r.direction.z);
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+        __m256 e1x = _mm256_load_ps(b.e1x), e1y = _mm256_load_ps(b.e1y), e1z = _mm256_load_ps(b.e1z);
+        __m256 e2x = _mm256_load_ps(b.e2x), e2y = _mm256_load_ps(b.e2y), e2z = _mm256_load_ps(b.e2z);
+
+        __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+        __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+        __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+        __m256 determinant = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+        __m256 mask = _mm256_cmp_ps(_mm256_andnot_ps(signMask, determinant), _mm256_set1_ps(DETERMINANT_EPSILON), _CMP_GE_OQ);
+        if (_mm256_movemask_ps(mask) == 0)
+            return 0;
+
+        __m256 inverseDeterminant = _mm256_div_ps(_mm256_set1_ps(1.0f), determinant);
+
+        __m256 sx = _mm256_sub_ps(_mm256_set1_ps(r.origin.x), _mm256_load_ps(b.v0x));
+        __m256 sy = _mm256_sub_ps(_mm256_set1_ps(r.origin.y), _mm256_load_ps(b.v0y));
+        __m256 sz = _mm256_sub_ps(_mm256_set1_ps(r.origin.z), _mm256_load_ps(b.v0z));
+        __m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)), inverseDeterminant);
+
+        const __m256 lower = _mm256_set1_ps(-BARYCENTRIC_TOLERANCE);
+        const __m256 upper = _mm256_set1_ps(1.0f + BARYCENTRIC_TOLERANCE);
+        mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, lower, _CMP_GE_OQ), _mm256_cmp_ps(u, upper, _CMP_LE_OQ)));
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+        __m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)), inverseDeterminant);
+        mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(v, lower, _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), upper, _CMP_LE_OQ)));
+
+        __m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), inverseDeterminant);
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LE_OQ));
+
+        int bits = _mm256_movemask_ps(mask);
+        if (bits == 0)
+            return 0;
+
+        _mm256_store_ps(tLanes, t);
+        _mm256_store_ps(uLanes, u);
+        _mm256_store_ps(vLanes, v);
+        return bits;
+    }
+#endif
+
+    IntersectFunction functionFor(TriangleBlock::InstructionSet set)
+    {
+#ifdef TRIANGLE_BLOCK_X86
+        if (set == TriangleBlock::AVX2)
+            return intersectAVX2;
+        if (set == TriangleBlock::SSE)
+            return intersectSSE;
+#endif
+        (void)set;
+        return intersectScalar;
+    }
+
+    TriangleBlock::InstructionSet currentSet = TriangleBlock::bestInstructionSet();
+    IntersectFunction currentFunction = functionFor(currentSet);
+}
+
+TriangleBlock::TriangleBlock()
+{
+    //Every lane starts out as a degenerate triangle at the origin, which can never be hit
+    for (int lane = 0; lane < TRIANGLE_BLOCK_SIZE; lane++)
+    {
+        v0x[lane] = v0y[lane] = v0z[lane] = 0.0f;
+        e1x[lane] = e1y[lane] = e1z[lane] = 0.0f;
+        e2x[lane] = e2y[lane] = e2z[lane] = 0.0f;
+        index[lane] = std::numeric_limits<unsigned int>::max();
+    }
+}
+
+void TriangleBlock::set(int lane, const CompactTriangle &triangle, unsigned int triangleIndex)
+{
+    v0x[lane] = triangle.v0.x;
+    v0y[lane] = triangle.v0.y;
+    v0z[lane] = triangle.v0.z;
+    e1x[lane] = triangle.edge1.x;
+    e1y[lane] = triangle.edge1.y;
+    e1z[lane] = triangle.edge1.z;
+    e2x[lane] = triangle.edge2.x;
+    e2y[lane] = triangle.edge2.y;
+    e2z[lane] = triangle.edge2.z;
+    index[lane] = triangleIndex;
+}
+
+bool TriangleBlock::intersect(const Ray &r, float &tBest, float &uBest, float &vBest, unsigned int &indexBest) const
+{
+    alignas(32) float t[TRIANGLE_BLOCK_SIZE], u[TRIANGLE_BLOCK_SIZE], v[TRIANGLE_BLOCK_SIZE];
+    int mask = currentFunction(*this, r, tBest, t, u, v);
+    if (mask == 0)
+        return false;
+
+    return pickClosest(mask, t, u, v, index, tBest, uBest, vBest, indexBest);
+}
+
+int TriangleBlock::hitLanes(const Ray &r, float tMax, float *t) const
+{
+    alignas(32) float u[TRIANGLE_BLOCK_SIZE], v[TRIANGLE_BLOCK_SIZE];
+    return currentFunction(*this, r, tMax, t, u, v);
+}
+
+TriangleBlock::InstructionSet TriangleBlock::bestInstructionSet()
+{
+#ifdef TRIANGLE_BLOCK_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return AVX2;
+    return SSE;
+#else
+    return Scalar;
+#endif
+}
+
+TriangleBlock::InstructionSet TriangleBlock::instructionSet()
+{
+    return currentSet;
+}
+
+void TriangleBlock::setInstructionSet(InstructionSet set)
+{
+    if (set > bestInstructionSet())
+        set = bestInstructionSet();
+
+    currentSet = set;
+    currentFunction = functionFor(set);
+}
+
+const char *TriangleBlock::instructionSetName(InstructionSet set)
+{
+    switch (set)
+    {
+    case AVX2:
+        return "avx2";
+    case SSE:
+        return "sse";
+    default:
+        return "scalar";
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef TRIANGLEBLOCK_H
+#define TRIANGLEBLOCK_H
+
+#include "Triangle.h"
+#include "Ray.h"
+
+//Number of triangles stored side by side in one block (one AVX register, or two SSE registers)
+#define TRIANGLE_BLOCK_SIZE 8
+
+//Structure-of-arrays layout of up to TRIANGLE_BLOCK_SIZE compact triangles, so one ray can be tested
+//against the whole block with SIMD instructions. Unused lanes hold degenerate triangles that never hit
+class alignas(32) TriangleBlock
+{
+public:
+    float v0x[TRIANGLE_BLOCK_SIZE], v0y[TRIANGLE_BLOCK_SIZE], v0z[TRIANGLE_BLOCK_SIZE];
+    float e1x[TRIANGLE_BLOCK_SIZE], e1y[TRIANGLE_BLOCK_SIZE], e1z[TRIANGLE_BLOCK_SIZE];
+    float e2x[TRIANGLE_BLOCK_SIZE], e2y[TRIANGLE_BLOCK_SIZE], e2z[TRIANGLE_BLOCK_SIZE];
+
+    //Index of each lane's triangle in the scene's triangle list
+    unsigned int index[TRIANGLE_BLOCK_SIZE];
+
+    TriangleBlock();
+
+    void set(int lane, const CompactTriangle &triangle, unsigned int triangleIndex);
+
+    //Tests r against every lane and replaces the hit in tBest/uBest/vBest/indexBest if one is closer
+    //(or equally close with a lower index). Gives bit-for-bit the same answers as CompactTriangle::intersect
+    bool intersect(const Ray &r, float &tBest, float &uBest, float &vBest, unsigned int &indexBest) const;
+
+    //Returns a bit mask of the lanes hit by r at 0 < t <= tMax, with each of their distances in t
+    //t must have room for TRIANGLE_BLOCK_SIZE values and be aligned like the block
+    int hitLanes(const Ray &r, float tMax, float *t) const;
+
+    //The instruction set used by intersect(), picked at runtime from what the CPU supports
+    enum InstructionSet
+    {
+        Scalar,
+        SSE,
+        AVX2
+    };
+
+    static InstructionSet instructionSet();
+    static InstructionSet bestInstructionSet();
+    //Forces a particular instruction set (e.g. for benchmarking), capped at what the CPU supports
+    static void setInstructionSet(InstructionSet set);
+    static const char *instructionSetName(InstructionSet set);
+};
+
+#endif // TRIANGLEBLOCK_H
@@ -0,0 +1,58 @@
+#include "TripleBuffer.h"
+
+//Marks the image in between as published but not yet picked up by the reader
+#define FRESH_BIT 4
+
+TripleBuffer::TripleBuffer()
+{
+    backIndex = 0;
+    middle = 1;
+    frontIndex = 2;
+    imageWidth = 0;
+    imageHeight = 0;
+}
+
+bool TripleBuffer::Resize(long width, long height)
+{
+    imageWidth = 0;
+    imageHeight = 0;
+    for (int i = 0; i < 3; i++)
+        if (!images[i].Resize(width, height))
+            return false;
+    imageWidth = width;
+    imageHeight = height;
+    return true;
+}
+
+long TripleBuffer::width() const
+{
+    return imageWidth;
+}
+
+long TripleBuffer::height() const
+{
+    return imageHeight;
+}
+
+RGBAImage *TripleBuffer::back()
+{
+    return &images[backIndex];
+}
+
+RGBAImage *TripleBuffer::publish()
+{
+    //Release makes the writes to the image visible to the reader before it can pick up the index
+    int previous = middle.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel);
+    backIndex = previous & ~FRESH_BIT;
+    return &images[backIndex];
+}
+
+const RGBAImage &TripleBuffer::front()
+{
+    if (middle.load(std::memory_order_relaxed) & FRESH_BIT)
+    {
+        int previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & ~FRESH_BIT;
+    }
+    return images[frontIndex];
+}
@@ -0,0 +1,43 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+#include "RGBAImage.h"
+
+//Three images passed between one writer (the render thread) and one reader (the display) without locks
+//The writer draws into the back image and publishes it when it is complete; the reader picks up the
+//most recently published image. Neither side ever waits for the other, and the reader never sees an
+//image that is still being drawn
+class TripleBuffer
+{
+public:
+    TripleBuffer();
+
+    //Resizes and clears all three images. Neither side may be using them while this runs
+    //Returns false if any of them cannot be resized, and the size is then 0 x 0 until a Resize() succeeds
+    bool Resize(long width, long height);
+    long width() const;
+    long height() const;
+
+    //Writer: the image to draw into
+    RGBAImage *back();
+    //Writer: hands the back image to the reader and returns the image to draw the next frame into
+    //(which holds an older frame, so the writer must redraw all of it before publishing again)
+    RGBAImage *publish();
+
+    //Reader: the latest published image, or the one it had last time if nothing new has been published
+    const RGBAImage &front();
+
+private:
+    RGBAImage images[3];
+    //Kept apart from the images, which may be left at different sizes by a failed Resize()
+    long imageWidth, imageHeight;
+
+    //Each side owns one image, the third sits in between and is swapped atomically
+    int backIndex;
+    int frontIndex;
+    //Index of the image in between, plus FRESH_BIT if it was published since the reader last looked
+    std::atomic<int> middle;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,405 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Headless batch renderer
+//
+//  Loads an OBJ/MTL pair, ray traces it with the same code as the
+//  Raytrace button in RaytraceRenderWindow, writes the image and exits.
+//  No Qt and no display are needed, so it can run on render nodes.
+//
+////////////////////////////////////////////////////////////////////////
+
+// system libraries
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+
+// local includes
+#include "ThreeDModel.h"
+#include "ObjReader.h"
+#include "SceneCache.h"
+#include "RenderParameters.h"
+#include "Scene.h"
+#include "Raytracer.h"
+#include "RGBAImage.h"
+#include "FloatImage.h"
+#include "TileWriter.h"
+#include "BandedRender.h"
+#include "TriangleBlock.h"
+
+// images with more pixels than this are rendered in bands unless --bands says otherwise
+#define LARGE_IMAGE_PIXELS (4096L * 4096L)
+// and the rows in each band when they are
+#define DEFAULT_BAND_HEIGHT 256
+
+// select the triangle test by name, returns false if the name is not known
+static bool parseInstructionSet(const std::string &name)
+    { // parseInstructionSet()
+    for (int set = TriangleBlock::Scalar; set <= TriangleBlock::AVX2; set++)
+        if (name == TriangleBlock::instructionSetName(TriangleBlock::InstructionSet(set)))
+        {
+            TriangleBlock::setInstructionSet(TriangleBlock::InstructionSet(set));
+            return true;
+        }
+    return false;
+    } // parseInstructionSet()
+
+// print the usage message
+static void printUsage(const char *program)
+    { // printUsage()
+    std::cout << "Usage: " << program << " geometry.obj material.mtl [options]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  -o file.ppm|file.pfm    output image, 8 bit binary PPM or float PFM radiance (default render.ppm)" << std::endl;
+    std::cout << "  --ascii                 write an ASCII (P3) PPM instead of a binary one" << std::endl;
+    std::cout << "  --stream                write each tile to the output as it renders, rather than the image at the end" << std::endl;
+    std::cout << "  --size WxH              image resolution (default 640x480)" << std::endl;
+    std::cout << "  --bands rows            render this many rows at a time straight into the output, to bound memory" << std::endl;
+    std::cout << "                          (default: bands of " << DEFAULT_BAND_HEIGHT << " for images over " << LARGE_IMAGE_PIXELS << " pixels, 0 for never)" << std::endl;
+    std::cout << "  --resume                carry on an interrupted banded render of the same output, skipping its finished bands" << std::endl;
+    std::cout << "  --rotate x y z degrees  rotate the model about an axis (may be repeated)" << std::endl;
+    std::cout << "  --translate x y z       translate the model (same units as the sliders)" << std::endl;
+    std::cout << "  --copy x y z            add a copy of the model, moved by x y z (may be repeated)" << std::endl;
+    std::cout << "  --interpolation         barycentric interpolation of normals" << std::endl;
+    std::cout << "  --phong                 Blinn-Phong shading" << std::endl;
+    std::cout << "  --shadows               shadows" << std::endl;
+    std::cout << "  --reflection            reflections" << std::endl;
+    std::cout << "  --path-tracing          path traced global illumination (instead of the options above)" << std::endl;
+    std::cout << "  --ortho                 orthographic projection" << std::endl;
+    std::cout << "  --linear                test every triangle instead of using the BVH" << std::endl;
+    std::cout << "  --no-packets            trace primary rays one at a time" << std::endl;
+    std::cout << "  --simd scalar|sse|avx2  instruction set for triangle tests (default: best available)" << std::endl;
+    std::cout << "  --samples n             samples per pixel (default " << N_LOOPS << ")" << std::endl;
+    std::cout << "  --light-samples n       shadow rays per area light (default " << N_LIGHT_SAMPLES << ", 0 for hard shadows)" << std::endl;
+    std::cout << "  --sampled-lights n      lights per shading point in scenes with more (default " << N_SAMPLED_LIGHTS << ", 0 for all)" << std::endl;
+    std::cout << "  --adaptive threshold    stop sampling pixels whose brightness has settled to within this (default " << ADAPTIVE_THRESHOLD << ", 0 for off)" << std::endl;
+    std::cout << "  --exposure stops        brighten (or, if negative, darken) the image by this many stops (default 0)" << std::endl;
+    std::cout << "  --tone-map              compress highlights with Reinhard's curve instead of clipping them" << std::endl;
+    std::cout << "  --time seconds          stop sampling after this long (default: no limit)" << std::endl;
+    std::cout << "  --threads n             render threads (default: one per hardware thread)" << std::endl;
+    std::cout << "  --tile n                tile size in pixels (default 16)" << std::endl;
+    std::cout << "  --tile-times file.csv   write the render time of every tile" << std::endl;
+    std::cout << "  --no-cache              parse the .obj even if its scene cache is up to date, and write no cache" << std::endl;
+    } // printUsage()
+
+// main routine
+int main(int argc, char **argv)
+    { // main()
+    //check the args to make sure there's an input file
+    if (argc < 3)
+    {   //bad arg count
+        printUsage(argv[0]);
+        return 1;
+    } // bad arg count
+
+    // create some default render parameters
+    RenderParameters renderParameters;
+    std::string outputFilename = "render.ppm";
+    std::string tileTimesFilename;
+    bool useCache = true;
+    bool asciiOutput = false;
+    bool streamOutput = false;
+    bool resume = false;
+    // rows per band, -1 until chosen by size
+    long bandHeight = -1;
+    long width = 640, height = 480;
+    // offsets of the extra copies of the model
+    std::vector<Cartesian3> copies;
+
+    // and walk through the options
+    for (int arg = 3; arg < argc; arg++)
+    { // per argument
+        std::string option = argv[arg];
+        // how many values are left after the option itself
+        int remaining = argc - arg - 1;
+
+        if (option == "-o" && remaining >= 1)
+            outputFilename = argv[++arg];
+        else if (option == "--size" && remaining >= 1)
+        {
+            if (sscanf(argv[++arg], "%ldx%ld", &width, &height) != 2)
+            {
+                std::cout << "Bad image size " << argv[arg] << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--rotate" && remaining >= 4)
+        {
+            Cartesian3 axis(std::atof(argv[arg + 1]), std::atof(argv[arg + 2]), std::atof(argv[arg + 3]));
+            float degrees = std::atof(argv[arg + 4]);
+            arg += 4;
+
+            Matrix4 rotation;
+            rotation.SetRotation(axis, degrees * float(M_PI) / 180.0f);
+            renderParameters.rotationMatrix = rotation * renderParameters.rotationMatrix;
+        }
+        else if (option == "--translate" && remaining >= 3)
+        {
+            renderParameters.xTranslate = std::atof(argv[++arg]);
+            renderParameters.yTranslate = std::atof(argv[++arg]);
+            renderParameters.zTranslate = std::atof(argv[++arg]);
+        }
+        else if (option == "--copy" && remaining >= 3)
+        {
+            Cartesian3 offset(std::atof(argv[arg + 1]), std::atof(argv[arg + 2]), std::atof(argv[arg + 3]));
+            arg += 3;
+            copies.push_back(offset);
+        }
+        else if (option == "--interpolation")
+            renderParameters.interpolationRendering = true;
+        else if (option == "--phong")
+            renderParameters.phongEnabled = true;
+        else if (option == "--shadows")
+            renderParameters.shadowsEnabled = true;
+        else if (option == "--reflection")
+            renderParameters.reflectionEnabled = true;
+        else if (option == "--path-tracing")
+            renderParameters.pathTracing = true;
+        else if (option == "--ortho")
+            renderParameters.orthoProjection = true;
+        else if (option == "--linear")
+            renderParameters.bvhEnabled = false;
+        else if (option == "--no-packets")
+            renderParameters.packetTracing = false;
+        else if (option == "--no-cache")
+            useCache = false;
+        else if (option == "--ascii")
+            asciiOutput = true;
+        else if (option == "--stream")
+            streamOutput = true;
+        else if (option == "--bands" && remaining >= 1)
+            bandHeight = std::max(0, std::atoi(argv[++arg]));
+        else if (option == "--resume")
+            resume = true;
+        else if (option == "--samples" && remaining >= 1)
+            renderParameters.sampleBudget = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--light-samples" && remaining >= 1)
+            renderParameters.lightSamples = std::max(0, std::atoi(argv[++arg]));
+        else if (option == "--sampled-lights" && remaining >= 1)
+            renderParameters.sampledLights = std::max(0, std::atoi(argv[++arg]));
+        else if (option == "--adaptive" && remaining >= 1)
+            renderParameters.adaptiveThreshold = std::max(0.0, std::atof(argv[++arg]));
+        else if (option == "--exposure" && remaining >= 1)
+            renderParameters.exposure = std::atof(argv[++arg]);
+        else if (option == "--tone-map")
+            renderParameters.toneMapping = true;
+        else if (option == "--time" && remaining >= 1)
+            renderParameters.timeBudget = std::atof(argv[++arg]);
+        else if (option == "--threads" && remaining >= 1)
+            renderParameters.threadCount = std::max(0, std::atoi(argv[++arg]));
+        else if (option == "--tile" && remaining >= 1)
+            renderParameters.tileSize = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--tile-times" && remaining >= 1)
+            tileTimesFilename = argv[++arg];
+        else if (option == "--simd" && remaining >= 1)
+        {
+            if (!parseInstructionSet(argv[++arg]))
+            {
+                std::cout << "Unknown instruction set " << argv[arg] << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << "Unknown or incomplete option " << option << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    } // per argument
+
+    // open the input files for the geometry & material
+    std::ifstream geometryFile(argv[1]);
+    std::ifstream materialFile(argv[2]);
+
+    if (!(geometryFile.good()) || !(materialFile.good()))
+    {
+        std::cout << "Read failed for object " << argv[1] << " or material " << argv[2] << std::endl;
+        return 1;
+    } // object read failed
+
+    // the geometry is parsed on as many threads as the render uses
+    auto loadStart = std::chrono::steady_clock::now();
+    SceneCache sceneCache(renderParameters.threadCount);
+    std::vector<ThreeDModel> texturedObjects;
+    if (useCache)
+        texturedObjects = sceneCache.load(argv[1], argv[2]);
+    else
+    {
+        ObjReader objReader(renderParameters.threadCount);
+        texturedObjects = objReader.read(argv[1], materialFile);
+    }
+    if (texturedObjects.size() == 0)
+    {
+        std::cout << "Read failed for object " << argv[1] << " or material " << argv[2] << std::endl;
+        return 1;
+    } // object read failed
+
+    renderParameters.findLights(texturedObjects);
+
+    // large images are rendered in bands, which go straight to the file, so the whole image is never in memory
+    if (bandHeight < 0)
+        bandHeight = width * height > LARGE_IMAGE_PIXELS ? DEFAULT_BAND_HEIGHT : 0;
+    bool banded = bandHeight > 0;
+    if (banded && asciiOutput)
+    {
+        std::cout << "ASCII output cannot be rendered in bands" << std::endl;
+        return 1;
+    }
+    if (resume && !banded)
+    {
+        std::cout << "Only banded renders can be resumed" << std::endl;
+        return 1;
+    }
+
+    // the image we render into (when banded, BandedRender gives the raytracer one band at a time instead)
+    RGBAImage frameBuffer;
+    if (!banded && !frameBuffer.Resize(width, height))
+        return 1;
+
+    Scene scene(&texturedObjects, &renderParameters);
+    Raytracer raytracer(&scene, &renderParameters, &frameBuffer);
+    raytracer.setTone(renderParameters.exposure, renderParameters.toneMapping);
+
+    // PFM files hold the radiance itself, before exposure, tone mapping and gamma
+    TileWriter::Format outputFormat = TileWriter::formatFor(outputFilename);
+    if (outputFormat == TileWriter::PFM && asciiOutput)
+    {
+        std::cout << "PFM output is always binary" << std::endl;
+        return 1;
+    }
+    FloatImage radianceImage;
+    if (outputFormat == TileWriter::PFM && !banded && !radianceImage.Resize(width, height))
+        return 1;
+
+    // when streaming, every tile goes to the file as soon as it is drawn, so the file always holds the latest pass
+    TileWriter tileWriter;
+    if (streamOutput && !banded)
+    { // streaming
+        if (asciiOutput)
+        {
+            std::cout << "ASCII output cannot be streamed" << std::endl;
+            return 1;
+        }
+        if (!tileWriter.open(outputFilename, outputFormat, width, height))
+        {
+            std::cout << "Could not open " << outputFilename << " for writing" << std::endl;
+            return 1;
+        }
+        if (outputFormat == TileWriter::PFM)
+            raytracer.tileCompleted = [&](const TileScheduler::Tile &tile)
+                {
+                raytracer.radiance(tile, radianceImage);
+                tileWriter.writeTile(tile, radianceImage);
+                };
+        else
+            raytracer.tileCompleted = [&](const TileScheduler::Tile &tile) { tileWriter.writeTile(tile, *raytracer.frameBuffer); };
+    } // streaming
+
+    auto renderStart = std::chrono::steady_clock::now();
+    scene.updateScene();
+    // the copies share the meshes of the original, so only the top level BVH grows
+    if (!copies.empty())
+    {
+        unsigned int models = texturedObjects.size();
+        for (const Cartesian3 &offset : copies)
+        {
+            Matrix4 translation;
+            translation.SetTranslation(offset);
+            for (unsigned int model = 0; model < models; model++)
+                scene.addInstance(model, translation);
+        }
+        scene.updateScene();
+    }
+    BandedRender bandedRender(&raytracer);
+    bool written = true;
+    if (banded)
+        written = bandedRender.render(outputFilename, outputFormat, width, height, bandHeight, resume);
+    else
+        raytracer.Render();
+    auto renderEnd = std::chrono::steady_clock::now();
+
+    if (banded)
+    { // banded
+        if (bandedRender.bandsSkipped > 0)
+            std::cout << "Resumed " << outputFilename << ", skipping " << bandedRender.bandsSkipped << " finished bands" << std::endl;
+        std::cout << "Rendered " << bandedRender.bandsRendered << " bands of " << bandHeight << " rows" << std::endl;
+    } // banded
+    else if (streamOutput)
+        written = tileWriter.close();
+    else
+    { // whole image
+        std::ofstream outputFile(outputFilename.c_str(), std::ios::binary);
+        if (!outputFile.good())
+        {
+            std::cout << "Could not open " << outputFilename << " for writing" << std::endl;
+            return 1;
+        }
+
+        if (outputFormat == TileWriter::PFM)
+        {
+            // PFM is stored bottom row first, like the frame buffer
+            TileScheduler::Tile wholeImage;
+            wholeImage.x = 0;
+            wholeImage.y = 0;
+            wholeImage.width = width;
+            wholeImage.height = height;
+            raytracer.radiance(wholeImage, radianceImage);
+            radianceImage.WritePFM(outputFile);
+        }
+        else
+        {
+            // the frame buffer is stored bottom row first (as glDrawPixels wants it), but PPM is top row first
+            RGBAImage flipped(frameBuffer);
+            for (long row = 0; row < height; row++)
+                for (long col = 0; col < width; col++)
+                    flipped[row][col] = frameBuffer[height - 1 - row][col];
+
+            if (asciiOutput)
+                flipped.WritePPM(outputFile);
+            else
+                flipped.WriteBinaryPPM(outputFile);
+        }
+        outputFile.close();
+        written = !outputFile.fail();
+    } // whole image
+    if (!written)
+    {
+        std::cout << "Failed writing " << outputFilename << std::endl;
+        return 1;
+    }
+    auto writeEnd = std::chrono::steady_clock::now();
+
+    double loadSeconds = std::chrono::duration<double>(renderStart - loadStart).count();
+    double renderSeconds = std::chrono::duration<double>(renderEnd - renderStart).count();
+    std::cout << "Loaded " << argv[1] << (sceneCache.usedCache() ? " from its cache" : "") << " in " << loadSeconds * 1000.0 << " ms" << std::endl;
+    std::cout << "Rendered " << width << "x" << height << " at " << raytracer.samplesTaken << " samples per pixel in " << renderSeconds * 1000.0 << " ms"
+              << " (" << TriangleBlock::instructionSetName(TriangleBlock::instructionSet()) << ", "
+              << raytracer.scheduler.threadCount() << " threads)" << std::endl;
+    // the raytracer's counts (and tile times) only cover the last band of a banded render
+    if (renderParameters.adaptiveThreshold > 0.0f && !banded)
+        std::cout << "Adaptive sampling traced " << double(raytracer.samplesTraced) / (width * height) << " samples per pixel on average" << std::endl;
+    if (!banded)
+        std::cout << "Wrote " << outputFilename << " in " << std::chrono::duration<double>(writeEnd - renderEnd).count() * 1000.0 << " ms" << std::endl;
+
+    // per-tile timings, e.g. to see where the image is expensive or how evenly the threads were loaded
+    if (!tileTimesFilename.empty())
+    { // tile times
+        std::ofstream tileFile(tileTimesFilename.c_str());
+        if (!tileFile.good())
+        {
+            std::cout << "Could not open " << tileTimesFilename << " for writing" << std::endl;
+            return 1;
+        }
+        tileFile << "x,y,width,height,worker,ms" << std::endl;
+        for (const TileScheduler::Tile &tile : raytracer.scheduler.tiles())
+            tileFile << tile.x << "," << tile.y << "," << tile.width << "," << tile.height << ","
+                     << tile.worker << "," << tile.milliseconds << std::endl;
+        std::cout << "Wrote " << tileTimesFilename << std::endl;
+    } // tile times
+
+    return 0;
+    } // main()
@@ -0,0 +1,312 @@
+//////////////////////////////////////////////////////////////////////
+//
+//  Render benchmark
+//
+//  Renders each of the bundled scenes in objects/ at fixed resolutions
+//  with every combination of the phong, shadow and reflection flags,
+//  and prints one CSV line per run so results can be tracked over time:
+//  ms per frame, rays per second and peak resident memory.
+//
+//  With --load it times loading each scene instead, with the stream
+//  reader, the memory mapped ObjReader and from the SceneCache.
+//
+////////////////////////////////////////////////////////////////////////
+
+// system libraries
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+// local includes
+#include "ThreeDModel.h"
+#include "ObjReader.h"
+#include "SceneCache.h"
+#include "RenderParameters.h"
+#include "Scene.h"
+#include "Raytracer.h"
+#include "RGBAImage.h"
+#include "TriangleBlock.h"
+
+// the scenes we measure, found in the objects directory as name.obj / name.mtl
+static const char *benchmarkScenes[] =
+    {
+    "cornell_box",
+    "cornellbox_suzanne",
+    "sphere",
+    "cube_backplane",
+    "triangle_backplane"
+    };
+
+// the fixed resolutions each scene is rendered at
+static const long benchmarkSizes[][2] =
+    {
+    {160, 120},
+    {320, 240}
+    };
+
+// peak resident set size of the process in kilobytes (0 if unknown)
+static long peakRSS()
+    { // peakRSS()
+#ifdef __unix__
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return 0;
+    } // peakRSS()
+
+// reset the peak so each scene reports its own high water mark
+// (only Linux supports this, elsewhere the value is the peak of the whole run so far)
+static void resetPeakRSS()
+    { // resetPeakRSS()
+#ifdef __linux__
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs.good())
+        clearRefs << "5" << std::endl;
+#endif
+    } // resetPeakRSS()
+
+// the longest any one tile took in the last frame, which bounds how well the frame can scale
+static double slowestTile(const Raytracer &raytracer)
+    { // slowestTile()
+    double slowest = 0.0;
+    for (const TileScheduler::Tile &tile : raytracer.scheduler.tiles())
+        slowest = std::max(slowest, tile.milliseconds);
+    return slowest;
+    } // slowestTile()
+
+// number of triangles the faces of the models make
+static size_t countTriangles(const std::vector<ThreeDModel> &models)
+    { // countTriangles()
+    size_t triangles = 0;
+    for (const ThreeDModel &model : models)
+        triangles += model.cornerVertices.size() - 2 * size_t(model.faceCount());
+    return triangles;
+    } // countTriangles()
+
+// times loading each scene with both readers, one CSV line per scene and reader
+static int benchmarkLoading(const std::vector<std::string> &sceneNames, const std::string &objectDirectory, int repeats, unsigned int threads)
+    { // benchmarkLoading()
+    std::cout << "scene,reader,threads,bytes,models,triangles,load_ms,mb_per_second,peak_rss_kb" << std::endl;
+
+    static const char *readerNames[] = {"stream", "mapped", "cache"};
+
+    ObjReader objReader(threads);
+    SceneCache sceneCache(threads);
+    for (const std::string &sceneName : sceneNames)
+    { // per scene
+        std::string objectFilename = objectDirectory + "/" + sceneName + ".obj";
+        std::string materialFilename = objectDirectory + "/" + sceneName + ".mtl";
+        std::string cacheFilename = SceneCache::cacheFilename(objectFilename);
+
+        // reader 0 is ThreeDModel::ReadObjectStreamMaterial, reader 1 the ObjReader, reader 2 the SceneCache
+        for (int reader = 0; reader < 3; reader++)
+        { // per reader
+            resetPeakRSS();
+            double bestMilliseconds = 0.0;
+            size_t bytes = 0;
+            size_t modelCount = 0;
+            size_t triangles = 0;
+            for (int repeat = 0; repeat < repeats; repeat++)
+            {
+                std::ifstream geometryFile(objectFilename.c_str());
+                std::ifstream materialFile(materialFilename.c_str());
+                if (!(geometryFile.good()) || !(materialFile.good()))
+                {
+                    std::cerr << "Read failed for object " << objectFilename << " or material " << materialFilename << std::endl;
+                    return 1;
+                }
+
+                // the cache is brought up to date once, outside the timing
+                if (reader == 2 && repeat == 0
+                    && !sceneCache.write(cacheFilename, objectFilename, materialFilename, objReader.read(objectFilename, materialFile)))
+                {
+                    std::cerr << "Could not write " << cacheFilename << std::endl;
+                    return 1;
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                std::vector<ThreeDModel> models;
+                if (reader == 0)
+                    models = ThreeDModel::ReadObjectStreamMaterial(geometryFile, materialFile);
+                else if (reader == 1)
+                    models = objReader.read(objectFilename, materialFile);
+                else
+                    sceneCache.read(cacheFilename, objectFilename, materialFilename, models);
+                auto end = std::chrono::steady_clock::now();
+
+                double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+                if (repeat == 0 || milliseconds < bestMilliseconds)
+                    bestMilliseconds = milliseconds;
+                geometryFile.clear();
+                geometryFile.seekg(0, std::ios::end);
+                bytes = size_t(geometryFile.tellg());
+                modelCount = models.size();
+                triangles = countTriangles(models);
+            }
+
+            double megabytesPerSecond = bestMilliseconds > 0.0 ? bytes / 1048576.0 / (bestMilliseconds / 1000.0) : 0.0;
+
+            char line[512];
+            snprintf(line, sizeof(line), "%s,%s,%u,%zu,%zu,%zu,%.3f,%.1f,%ld",
+                     sceneName.c_str(), readerNames[reader], reader == 1 ? objReader.threadCount() : 1u,
+                     bytes, modelCount, triangles, bestMilliseconds, megabytesPerSecond, peakRSS());
+            std::cout << line << std::endl;
+        } // per reader
+    } // per scene
+
+    return 0;
+    } // benchmarkLoading()
+
+// main routine
+int main(int argc, char **argv)
+    { // main()
+    std::string objectDirectory = "objects";
+    std::vector<std::string> sceneNames;
+    bool loadOnly = false;
+    int repeats = 3;
+    bool packets = true;
+    unsigned int threads = 0;
+    int tileSize = 16;
+
+    for (int arg = 1; arg < argc; arg++)
+    { // per argument
+        std::string option = argv[arg];
+        if (option == "--objects" && arg + 1 < argc)
+            objectDirectory = argv[++arg];
+        else if (option == "--scene" && arg + 1 < argc)
+            sceneNames.push_back(argv[++arg]);
+        else if (option == "--load")
+            loadOnly = true;
+        else if (option == "--repeat" && arg + 1 < argc)
+            repeats = std::max(1, std::atoi(argv[++arg]));
+        else if (option == "--simd" && arg + 1 < argc)
+        {
+            std::string name = argv[++arg];
+            bool known = false;
+            for (int set = TriangleBlock::Scalar; set <= TriangleBlock::AVX2; set++)
+                if (name == TriangleBlock::instructionSetName(TriangleBlock::InstructionSet(set)))
+                {
+                    TriangleBlock::setInstructionSet(TriangleBlock::InstructionSet(set));
+                    known = true;
+                }
+            if (!known)
+            {
+                std::cout << "Unknown instruction set " << name << std::endl;
+                return 1;
+            }
+        }
+        else if (option == "--no-packets")
+            packets = false;
+        else if (option == "--threads" && arg + 1 < argc)
+            threads = std::max(0, std::atoi(argv[++arg]));
+        else if (option == "--tile" && arg + 1 < argc)
+            tileSize = std::max(1, std::atoi(argv[++arg]));
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--objects directory] [--scene name] [--load] [--repeat n] [--simd scalar|sse|avx2] [--no-packets]"
+                      << " [--threads n] [--tile n]" << std::endl;
+            return 1;
+        }
+    } // per argument
+
+    // without --scene, every bundled scene
+    if (sceneNames.empty())
+        sceneNames.assign(std::begin(benchmarkScenes), std::end(benchmarkScenes));
+
+    if (loadOnly)
+        return benchmarkLoading(sceneNames, objectDirectory, repeats, threads);
+
+    // header line for the CSV
+    std::cout << "scene,width,height,phong,shadows,reflection,threads,tile,simd,packets,triangles,load_ms,ms_per_frame,slowest_tile_ms,rays_per_frame,rays_per_second,peak_rss_kb" << std::endl;
+
+    ObjReader objReader(threads);
+    for (const std::string &sceneName : sceneNames)
+    { // per scene
+        std::string objectFilename = objectDirectory + "/" + sceneName + ".obj";
+        std::string materialFilename = objectDirectory + "/" + sceneName + ".mtl";
+
+        resetPeakRSS();
+
+        std::ifstream geometryFile(objectFilename.c_str());
+        std::ifstream materialFile(materialFilename.c_str());
+        if (!(geometryFile.good()) || !(materialFile.good()))
+        {
+            std::cerr << "Read failed for object " << objectFilename << " or material " << materialFilename << std::endl;
+            return 1;
+        }
+
+        auto loadStart = std::chrono::steady_clock::now();
+        std::vector<ThreeDModel> texturedObjects = objReader.read(objectFilename, materialFile);
+        auto loadEnd = std::chrono::steady_clock::now();
+        double loadMilliseconds = std::chrono::duration<double, std::milli>(loadEnd - loadStart).count();
+
+        RenderParameters renderParameters;
+        renderParameters.packetTracing = packets;
+        renderParameters.threadCount = threads;
+        renderParameters.tileSize = tileSize;
+        // one sample per pixel, so ms_per_frame is the cost of a single pass
+        renderParameters.sampleBudget = 1;
+        renderParameters.findLights(texturedObjects);
+
+        Scene scene(&texturedObjects, &renderParameters);
+        scene.updateScene();
+
+        for (const long *size : benchmarkSizes)
+        { // per size
+            RGBAImage frameBuffer;
+            frameBuffer.Resize(size[0], size[1]);
+            Raytracer raytracer(&scene, &renderParameters, &frameBuffer);
+
+            // bit 0 = phong, bit 1 = shadows, bit 2 = reflection
+            for (int flags = 0; flags < 8; flags++)
+            { // per flag combination
+                renderParameters.phongEnabled = (flags & 1) != 0;
+                renderParameters.shadowsEnabled = (flags & 2) != 0;
+                renderParameters.reflectionEnabled = (flags & 4) != 0;
+
+                // take the fastest of the repeats, which is the least disturbed by the rest of the machine
+                double bestMilliseconds = 0.0;
+                double bestSlowestTile = 0.0;
+                unsigned long long rays = 0;
+                for (int repeat = 0; repeat < repeats; repeat++)
+                {
+                    scene.resetRayCount();
+                    auto start = std::chrono::steady_clock::now();
+                    raytracer.Render();
+                    auto end = std::chrono::steady_clock::now();
+
+                    double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+                    if (repeat == 0 || milliseconds < bestMilliseconds)
+                    {
+                        bestMilliseconds = milliseconds;
+                        bestSlowestTile = slowestTile(raytracer);
+                    }
+                    rays = scene.rayCount;
+                }
+
+                double raysPerSecond = bestMilliseconds > 0.0 ? rays / (bestMilliseconds / 1000.0) : 0.0;
+
+                char line[512];
+                snprintf(line, sizeof(line), "%s,%ld,%ld,%d,%d,%d,%u,%d,%s,%d,%zu,%.3f,%.3f,%.3f,%llu,%.0f,%ld",
+                         sceneName.c_str(), size[0], size[1],
+                         int(renderParameters.phongEnabled), int(renderParameters.shadowsEnabled), int(renderParameters.reflectionEnabled),
+                         raytracer.scheduler.threadCount(), renderParameters.tileSize, TriangleBlock::instructionSetName(TriangleBlock::instructionSet()), int(packets),
+                         scene.triangleCount(), loadMilliseconds,
+                         bestMilliseconds, bestSlowestTile, rays, raysPerSecond, peakRSS());
+                std::cout << line << std::endl;
+            } // per flag combination
+        } // per size
+    } // per scene
+
+    return 0;
+    } // main()
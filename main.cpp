@@ -17,6 +17,7 @@
 // local includes
 #include "RenderWindow.h"
 #include "ThreeDModel.h"
+#include "SceneCache.h"
 #include "RenderParameters.h"
 #include "RenderController.h"
 
@@ -52,7 +53,9 @@ int main(int argc, char **argv)
     std::string s = argv[2];
     //if is actually passing a material. This will trigger the modified obj read code.
     if(s.find(".mtl") != std::string::npos){
-        texturedObjects = ThreeDModel::ReadObjectStreamMaterial(geometryFile, textureFile);
+        // later runs load the scene from a binary cache written the first time round
+        SceneCache sceneCache;
+        texturedObjects = sceneCache.load(argv[1], argv[2]);
     }else{
         std::cout << "Second file is not a material file!" << std::endl;
         return 0;